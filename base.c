@@ -1,7 +1,29 @@
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE
+#endif
+
 #include "base.h"
 #include "base_assert.h"
 #include "base_intrinsics.h"
 #include "base_string.h"
+#include "base_arena.h"
+#include "base_slab.h"
+#include "base_atomic.h"
+#include "base_thread_heap.h"
+
+#ifdef _WIN32
+EXTERN_C __declspec(dllimport) void* __stdcall VirtualAlloc(void* address, uintz size, unsigned long type, unsigned long protect);
+EXTERN_C __declspec(dllimport) int __stdcall VirtualFree(void* address, uintz size, unsigned long type);
+EXTERN_C __declspec(dllimport) int __stdcall QueryPerformanceCounter(union _LARGE_INTEGER* counter);
+EXTERN_C __declspec(dllimport) int __stdcall QueryPerformanceFrequency(union _LARGE_INTEGER* frequency);
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <sys/syscall.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <time.h>
+#endif
 
 thread_local ThreadContext g_thread_context_;
 
@@ -12,6 +34,1094 @@ ThisThreadContext(void)
 	return ctx;
 }
 
+API int32
+ThisThreadNumaNode(void)
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+	unsigned cpu, node;
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+		return (int32)node;
+#endif
+	return -1;
+}
+
+API void
+ThreadContextReserveScratch_(Arena* arena)
+{
+	Trace();
+	ThreadContext* thread_context = ThisThreadContext();
+	intz size = thread_context->scratch_reserve_size;
+	if (!size)
+		size = CONFIG_SCRATCH_ARENA_DEFAULT_SIZE;
+	
+	// NOTE(ljre): Scratch memory is only ever touched by its own thread, so keep it on its node.
+	ArenaReserveDesc desc = {
+		.reserve_size = size,
+		.numa_node = ThisThreadNumaNode(),
+	};
+	if (desc.numa_node >= 0)
+		desc.flags |= ArenaFlags_NumaNode;
+	
+	*arena = ArenaReserveEx(&desc);
+}
+
+API void
+ThreadContextReleaseScratch(void)
+{
+	Trace();
+	ThreadContext* thread_context = ThisThreadContext();
+	for (intz i = 0; i < ArrayLength(thread_context->scratch); ++i)
+	{
+		if (thread_context->scratch[i].memory)
+			ArenaRelease(&thread_context->scratch[i]);
+	}
+}
+
+//~ NOTE(ljre): Virtual memory
+static intz
+OsPageSize_(void)
+{
+#ifdef _WIN32
+	return 4 << 10;
+#else
+	static intz page_size;
+	if (!page_size)
+		page_size = (intz)sysconf(_SC_PAGESIZE);
+	return page_size;
+#endif
+}
+
+static void*
+OsReserve_(intz size)
+{
+	Trace();
+#ifdef _WIN32
+	return VirtualAlloc(NULL, (uintz)size, 0x00002000 /* MEM_RESERVE */, 0x01 /* PAGE_NOACCESS */);
+#else
+	void* result = mmap(NULL, (size_t)size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return (result == MAP_FAILED) ? NULL : result;
+#endif
+}
+
+static void*
+OsReserveHuge_(intz size)
+{
+	Trace();
+#if defined(_WIN32)
+	// NOTE(ljre): Large pages on Windows need to be committed up front and require a privilege.
+	return OsReserve_(size);
+#else
+	void* result;
+#	ifdef MAP_HUGETLB
+	// NOTE(ljre): No MAP_NORESERVE here, so mmap() fails right away if the hugetlb pool is too small
+	//             instead of us getting a SIGBUS when touching the pages later.
+	result = mmap(NULL, (size_t)size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (result != MAP_FAILED)
+		return result;
+#	endif
+	
+	// NOTE(ljre): Over-reserve so we can trim the reservation to a huge page boundary.
+	intz align = CONFIG_ARENA_HUGE_PAGE_SIZE;
+	uint8* raw = (uint8*)OsReserve_(size + align);
+	if (!raw)
+		return NULL;
+	uint8* aligned = (uint8*)AlignUp((uintptr)raw, (uintptr)align-1);
+	if (aligned > raw)
+		munmap(raw, (size_t)(aligned - raw));
+	if (raw + align > aligned)
+		munmap(aligned + size, (size_t)(raw + align - aligned));
+	result = aligned;
+	
+#	ifdef MADV_HUGEPAGE
+	madvise(result, (size_t)size, MADV_HUGEPAGE);
+#	endif
+	return result;
+#endif
+}
+
+static void*
+OsAllocate_(intz size)
+{
+	Trace();
+#ifdef _WIN32
+	return VirtualAlloc(NULL, (uintz)size, 0x00003000 /* MEM_RESERVE|MEM_COMMIT */, 0x04 /* PAGE_READWRITE */);
+#else
+	void* result = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return (result == MAP_FAILED) ? NULL : result;
+#endif
+}
+
+static bool
+OsCommit_(void* ptr, intz size)
+{
+	Trace();
+#ifdef _WIN32
+	return VirtualAlloc(ptr, (uintz)size, 0x00001000 /* MEM_COMMIT */, 0x04 /* PAGE_READWRITE */) != NULL;
+#else
+	return mprotect(ptr, (size_t)size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void
+OsDecommit_(void* ptr, intz size, bool lazy)
+{
+	Trace();
+#ifdef _WIN32
+	(void)lazy;
+	VirtualFree(ptr, (uintz)size, 0x00004000 /* MEM_DECOMMIT */);
+#else
+	int advice = MADV_DONTNEED;
+#	ifdef MADV_FREE
+	if (lazy)
+		advice = MADV_FREE;
+#	else
+	(void)lazy;
+#	endif
+	madvise(ptr, (size_t)size, advice);
+#endif
+}
+
+static void
+OsSetNumaNode_(void* ptr, intz size, int32 node)
+{
+	Trace();
+#if defined(__linux__) && defined(SYS_mbind)
+	// NOTE(ljre): MPOL_PREFERRED instead of MPOL_BIND, so we fall back to other nodes instead of failing
+	//             when this one is full. Errors (no NUMA support, node doesn't exist) are ignored.
+	enum { MaxNodes = 1024, MpolPreferred = 1 };
+	uint64 nodemask[MaxNodes / 64] = { 0 };
+	if (node < 0 || node >= MaxNodes)
+		return;
+	nodemask[node / 64] = (uint64)1 << (node % 64);
+	syscall(SYS_mbind, ptr, (unsigned long)size, MpolPreferred, nodemask, (unsigned long)MaxNodes + 1, 0);
+#else
+	(void)ptr;
+	(void)size;
+	(void)node;
+#endif
+}
+
+static void
+OsRelease_(void* ptr, intz size)
+{
+	Trace();
+#ifdef _WIN32
+	(void)size;
+	VirtualFree(ptr, 0, 0x00008000 /* MEM_RELEASE */);
+#else
+	munmap(ptr, (size_t)size);
+#endif
+}
+
+//~ NOTE(ljre): Virtual memory arenas
+API Arena
+ArenaReserve(intz reserve_size, intz commit_granularity)
+{
+	ArenaReserveDesc desc = {
+		.reserve_size = reserve_size,
+		.commit_granularity = commit_granularity,
+	};
+	
+	return ArenaReserveEx(&desc);
+}
+
+API Arena
+ArenaReserveEx(ArenaReserveDesc const* desc)
+{
+	Trace();
+	intz reserve_size = desc->reserve_size;
+	intz commit_granularity = desc->commit_granularity;
+	uint32 flags = desc->flags & (ArenaFlags_HugePages | ArenaFlags_NumaNode);
+	SafeAssert(reserve_size >= 0 && commit_granularity >= 0);
+	Assert(IsPowerOf2(commit_granularity));
+	
+	if (!commit_granularity)
+		commit_granularity = CONFIG_ARENA_DEFAULT_COMMIT_GRANULARITY;
+	commit_granularity = AlignUp(commit_granularity, OsPageSize_()-1);
+	if (flags & ArenaFlags_HugePages)
+		commit_granularity = AlignUp(commit_granularity, CONFIG_ARENA_HUGE_PAGE_SIZE-1);
+	reserve_size = AlignUp(reserve_size, commit_granularity-1);
+	
+	Arena result = { 0 };
+	uint8* memory = NULL;
+	
+	if (reserve_size && (flags & ArenaFlags_HugePages))
+		memory = (uint8*)OsReserveHuge_(reserve_size);
+	else if (reserve_size)
+		memory = (uint8*)OsReserve_(reserve_size);
+	
+	if (memory && (flags & ArenaFlags_NumaNode))
+		OsSetNumaNode_(memory, reserve_size, desc->numa_node);
+	
+	if (memory)
+	{
+		result.memory = memory;
+		result.reserved = reserve_size;
+		result.commit_granularity = commit_granularity;
+		result.commit_memory_proc = ArenaVirtualCommitMemoryProc;
+		result.flags = flags;
+		result.budget = desc->budget;
+	}
+	
+	return result;
+}
+
+API Arena
+ArenaChained(intz block_size)
+{
+	Trace();
+	SafeAssert(block_size >= 0);
+	
+	if (!block_size)
+		block_size = CONFIG_ARENA_DEFAULT_COMMIT_GRANULARITY;
+	block_size = AlignUp(block_size, OsPageSize_()-1);
+	
+	Arena result = { 0 };
+	ArenaBlock* block = (ArenaBlock*)OsAllocate_(block_size);
+	
+	if (block)
+	{
+		block->prev = NULL;
+		block->prev_offset = 0;
+		block->size = block_size;
+		
+		result.memory = (uint8*)block;
+		result.size = block_size;
+		result.offset = SignedSizeof(ArenaBlock);
+		result.flags = ArenaFlags_Chained;
+		result.block_size = block_size;
+	}
+	
+	return result;
+}
+
+#ifdef CONFIG_ARENA_STATS
+API int64
+ArenaStatsNanoseconds_(void)
+{
+#ifdef _WIN32
+	static int64 frequency;
+	if (!frequency)
+		QueryPerformanceFrequency((union _LARGE_INTEGER*)&frequency);
+	int64 counter;
+	QueryPerformanceCounter((union _LARGE_INTEGER*)&counter);
+	return counter / frequency * 1000000000 + counter % frequency * 1000000000 / frequency;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+#endif
+
+API ArenaStats
+ArenaGetScratchStats(void)
+{
+	ThreadContext* thread_context = ThisThreadContext();
+	ArenaStats total = { 0 };
+	
+	for (intz i = 0; i < ArrayLength(thread_context->scratch); ++i)
+	{
+		ArenaStats stats = ArenaGetStats(&thread_context->scratch[i]);
+		ArenaAccumulateStats(&total, &stats);
+	}
+	
+	return total;
+}
+
+API void
+ArenaLogStats(int32 level, char const* name, ArenaStats const* stats)
+{
+	Log(level, "arena '%s': peak=%Z pushes=%I padding=%I commits=%I commit_time=%Ius",
+		name,
+		stats->peak_offset,
+		stats->push_count,
+		stats->padding_bytes,
+		stats->commit_count,
+		stats->commit_nanoseconds / 1000);
+}
+
+API void*
+ArenaPushNewBlock_(Arena* arena, intz size, intz alignment)
+{
+	Trace();
+	Assert(arena->flags & ArenaFlags_Chained);
+	
+	intz needed = SignedSizeof(ArenaBlock) + size + alignment;
+	ArenaBlock* block = NULL;
+	
+	for (ArenaBlock** it = &arena->free_blocks; *it; it = &(*it)->prev)
+	{
+		if ((*it)->size >= needed)
+		{
+			block = *it;
+			*it = block->prev;
+			break;
+		}
+	}
+	
+	if (!block)
+	{
+		intz block_size = Max(arena->block_size, AlignUp(needed, OsPageSize_()-1));
+		if (arena->budget && !MemoryBudgetCharge(arena->budget, block_size))
+			return NULL;
+		block = (ArenaBlock*)OsAllocate_(block_size);
+		if (!block)
+		{
+			if (arena->budget)
+				MemoryBudgetRelease(arena->budget, block_size);
+			return NULL;
+		}
+		block->size = block_size;
+	}
+	
+	block->prev = (ArenaBlock*)arena->memory;
+	block->prev_offset = arena->offset;
+	
+	arena->memory = (uint8*)block;
+	arena->size = block->size;
+	arena->offset = SignedSizeof(ArenaBlock);
+	
+	return ArenaPushDirtyAligned(arena, size, alignment);
+}
+
+API void
+ArenaRelease(Arena* arena)
+{
+	Trace();
+	
+	if (arena->flags & ArenaFlags_Chained)
+	{
+		ArenaBlock* first = (ArenaBlock*)arena->memory;
+		ArenaBlock* free_blocks = arena->free_blocks;
+		MemoryBudget* budget = arena->budget;
+		intz released = 0;
+		
+		while (first->prev)
+		{
+			ArenaBlock* prev = first->prev;
+			released += first->size;
+			OsRelease_(first, first->size);
+			first = prev;
+		}
+		while (free_blocks)
+		{
+			ArenaBlock* next = free_blocks->prev;
+			released += free_blocks->size;
+			OsRelease_(free_blocks, free_blocks->size);
+			free_blocks = next;
+		}
+		
+		// NOTE(ljre): The arena might be bootstrapped inside its first block.
+		intz first_size = first->size;
+		if ((uint8*)arena < (uint8*)first || (uint8*)arena >= (uint8*)first + first_size)
+			MemoryZero(arena, SignedSizeof(*arena));
+		OsRelease_(first, first_size);
+		if (budget)
+			MemoryBudgetRelease(budget, released + first_size);
+		return;
+	}
+	
+	Assert(arena->commit_memory_proc == ArenaVirtualCommitMemoryProc || arena->commit_memory_proc == ArenaFileCommitMemoryProc);
+	
+	// NOTE(ljre): The arena might be bootstrapped inside its own memory, so copy what we need first.
+	uint8* memory = arena->memory;
+	intz reserved = arena->reserved;
+	bool is_file_backed = (arena->flags & ArenaFlags_FileBacked);
+	int32 fd = arena->fd;
+	MemoryBudget* budget = arena->budget;
+	intz committed = arena->size;
+	bool is_bootstrapped = ((uint8*)arena >= memory && (uint8*)arena < memory + reserved);
+	
+	if (!is_bootstrapped)
+		MemoryZero(arena, SignedSizeof(*arena));
+	if (memory)
+		OsRelease_(memory, reserved);
+	if (budget)
+		MemoryBudgetRelease(budget, committed);
+#ifndef _WIN32
+	if (is_file_backed)
+		close(fd);
+#else
+	(void)is_file_backed;
+	(void)fd;
+#endif
+}
+
+API bool
+ArenaVirtualCommitMemoryProc(Arena* arena, intz needed_size)
+{
+	Trace();
+	if (needed_size > arena->reserved)
+		return false;
+	intz old_size = arena->size;
+	if (needed_size <= old_size)
+	{
+		intz new_size = AlignUp(needed_size, arena->commit_granularity-1);
+		if (new_size < old_size)
+		{
+			OsDecommit_(arena->memory + new_size, old_size - new_size, arena->flags & ArenaFlags_LazyDecommit);
+			if (arena->budget)
+				MemoryBudgetRelease(arena->budget, old_size - new_size);
+			arena->size = new_size;
+		}
+		return true;
+	}
+	
+	intz new_size = AlignUp(needed_size, arena->commit_granularity-1);
+	new_size = ClampMax(new_size, arena->reserved);
+	
+	if (arena->budget && !MemoryBudgetCharge(arena->budget, new_size - old_size))
+		return false;
+	if (!OsCommit_(arena->memory + old_size, new_size - old_size))
+	{
+		if (arena->budget)
+			MemoryBudgetRelease(arena->budget, new_size - old_size);
+		return false;
+	}
+	
+	arena->size = new_size;
+	return true;
+}
+
+//~ NOTE(ljre): File backed arenas
+API Arena
+ArenaFromFd(int32 fd, intz reserve_size, intz commit_granularity)
+{
+	Trace();
+	SafeAssert(reserve_size >= 0 && commit_granularity >= 0);
+	Assert(IsPowerOf2(commit_granularity));
+	
+	Arena result = { 0 };
+#ifdef _WIN32
+	(void)fd;
+	return result;
+#else
+	if (!commit_granularity)
+		commit_granularity = CONFIG_ARENA_DEFAULT_COMMIT_GRANULARITY;
+	commit_granularity = AlignUp(commit_granularity, OsPageSize_()-1);
+	reserve_size = AlignUp(reserve_size, commit_granularity-1);
+	
+	struct stat st;
+	if (fd < 0)
+		return result;
+	if (!reserve_size || fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return result;
+	}
+	
+	// NOTE(ljre): Pages past the end of the file can't be touched (SIGBUS) until the file is grown, so
+	//             the whole reservation can be mapped read/write right away.
+	void* memory = mmap(NULL, (size_t)reserve_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+	if (memory == MAP_FAILED)
+	{
+		close(fd);
+		return result;
+	}
+	
+	result.memory = (uint8*)memory;
+	result.size = ClampMax((intz)st.st_size, reserve_size);
+	result.reserved = reserve_size;
+	result.commit_granularity = commit_granularity;
+	result.commit_memory_proc = ArenaFileCommitMemoryProc;
+	result.flags = ArenaFlags_FileBacked;
+	result.fd = fd;
+	
+	return result;
+#endif
+}
+
+API Arena
+ArenaFromFile(String path, intz reserve_size, intz commit_granularity)
+{
+	Trace();
+	Arena result = { 0 };
+#ifdef _WIN32
+	(void)path;
+	(void)reserve_size;
+	(void)commit_granularity;
+#else
+	char cpath[4096];
+	if (path.size >= SignedSizeof(cpath))
+		return result;
+	MemoryCopy(cpath, path.data, path.size);
+	cpath[path.size] = 0;
+	
+	int fd = open(cpath, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd >= 0)
+		result = ArenaFromFd(fd, reserve_size, commit_granularity);
+#endif
+	return result;
+}
+
+API Arena
+ArenaFromMemfd(String name, intz reserve_size, intz commit_granularity)
+{
+	Trace();
+	Arena result = { 0 };
+#ifdef __linux__
+	// NOTE(ljre): memfd names are limited to 249 bytes. It's only for debugging, so just cut it.
+	char cname[250];
+	intz name_size = ClampMax(name.size, SignedSizeof(cname)-1);
+	MemoryCopy(cname, name.data, name_size);
+	cname[name_size] = 0;
+	
+	int fd = memfd_create(cname, MFD_CLOEXEC);
+	if (fd >= 0)
+		result = ArenaFromFd(fd, reserve_size, commit_granularity);
+#else
+	(void)name;
+	(void)reserve_size;
+	(void)commit_granularity;
+#endif
+	return result;
+}
+
+API bool
+ArenaFileCommitMemoryProc(Arena* arena, intz needed_size)
+{
+	Trace();
+#ifdef _WIN32
+	(void)arena;
+	(void)needed_size;
+	return false;
+#else
+	if (needed_size > arena->reserved)
+		return false;
+	
+	intz old_size = arena->size;
+	intz new_size = AlignUp(needed_size, arena->commit_granularity-1);
+	new_size = ClampMax(new_size, arena->reserved);
+	
+	if (needed_size <= old_size)
+	{
+		// NOTE(ljre): The file might be mapped by other processes that still touch the pages past new_size,
+		//             so truncating it would make them SIGBUS. Punch a hole instead, which gives the pages
+		//             back but keeps the file size. Where that isn't supported, the pages are just kept.
+#ifdef MADV_REMOVE
+		if (new_size < old_size && madvise(arena->memory + new_size, (size_t)(old_size - new_size), MADV_REMOVE) == 0)
+		{
+			if (arena->budget)
+				MemoryBudgetRelease(arena->budget, old_size - new_size);
+			arena->size = new_size;
+		}
+#endif
+		return true;
+	}
+	
+	if (arena->budget && !MemoryBudgetCharge(arena->budget, new_size - old_size))
+		return false;
+	
+	// NOTE(ljre): Another process mapping the same file might have grown it already. Never shrink it here.
+	struct stat st;
+	if (fstat(arena->fd, &st) != 0 || ((intz)st.st_size < new_size && ftruncate(arena->fd, (off_t)new_size) != 0))
+	{
+		if (arena->budget)
+			MemoryBudgetRelease(arena->budget, new_size - old_size);
+		return false;
+	}
+	
+	arena->size = new_size;
+	return true;
+#endif
+}
+
+//~ NOTE(ljre): Arena forks
+API bool
+ArenaForkBegin(ArenaFork* fork, Arena* source)
+{
+	Trace();
+	MemoryZero(fork, SignedSizeof(*fork));
+#ifdef __linux__
+	if (!(source->flags & ArenaFlags_FileBacked))
+		return false;
+	
+	intz shared_size = AlignUp(source->size, OsPageSize_()-1);
+	uint8* memory = (uint8*)OsReserve_(source->reserved);
+	if (!memory)
+		return false;
+	
+	if (shared_size && mmap(memory, (size_t)shared_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, source->fd, 0) == MAP_FAILED)
+	{
+		OsRelease_(memory, source->reserved);
+		return false;
+	}
+	
+	// NOTE(ljre): Past shared_size, this is just a regular virtual memory arena.
+	fork->arena.memory = memory;
+	fork->arena.size = shared_size;
+	fork->arena.offset = source->offset;
+	fork->arena.reserved = source->reserved;
+	fork->arena.commit_granularity = source->commit_granularity;
+	fork->arena.commit_memory_proc = ArenaVirtualCommitMemoryProc;
+	fork->source = source;
+	fork->shared_size = shared_size;
+	
+	return true;
+#else
+	(void)source;
+	return false;
+#endif
+}
+
+API bool
+ArenaForkCommit(ArenaFork* fork)
+{
+	Trace();
+#ifdef __linux__
+	Arena* source = fork->source;
+	Arena* arena = &fork->arena;
+	intz page_size = OsPageSize_();
+	intz end = arena->offset;
+	
+	if (end > source->size && !ArenaCommit_(source, end))
+		return false;
+	
+	// NOTE(ljre): A page that the fork wrote to is no longer a file page. Bit 61 of its pagemap entry
+	//             says whether it is one, and bits 62-63 whether it exists at all (swapped or present).
+	intz shared_end = Min(end, fork->shared_size);
+	int pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	
+	for (intz offset = 0; offset < shared_end;)
+	{
+		uint64 entries[512];
+		intz page_count = Min((shared_end - offset + page_size - 1) / page_size, ArrayLength(entries));
+		intz read_size = page_count * SignedSizeof(uint64);
+		off_t entry_offset = (off_t)((uintptr)(arena->memory + offset) / (uintptr)page_size * sizeof(uint64));
+		
+		if (pagemap < 0 || pread(pagemap, entries, (size_t)read_size, entry_offset) != read_size)
+		{
+			for (intz i = 0; i < page_count; ++i)
+				entries[i] = (uint64)1 << 63;
+		}
+		
+		for (intz i = 0; i < page_count; ++i, offset += page_size)
+		{
+			bool exists = (entries[i] >> 62) != 0;
+			bool is_file_page = (entries[i] >> 61) & 1;
+			if (exists && !is_file_page)
+				MemoryCopy(source->memory + offset, arena->memory + offset, Min(page_size, shared_end - offset));
+		}
+	}
+	
+	if (pagemap >= 0)
+		close(pagemap);
+	if (end > fork->shared_size)
+		MemoryCopy(source->memory + fork->shared_size, arena->memory + fork->shared_size, end - fork->shared_size);
+	
+	source->offset = end;
+	ArenaForkDiscard(fork);
+	return true;
+#else
+	(void)fork;
+	return false;
+#endif
+}
+
+API void
+ArenaForkDiscard(ArenaFork* fork)
+{
+	Trace();
+	if (fork->arena.memory)
+		OsRelease_(fork->arena.memory, fork->arena.reserved);
+	MemoryZero(fork, SignedSizeof(*fork));
+}
+
+//~ NOTE(ljre): Slab allocator
+API intz
+SlabPageSize_(void)
+{
+	return OsPageSize_();
+}
+
+API void*
+SlabAllocatePages_(intz size)
+{
+	Trace();
+	return OsAllocate_(size);
+}
+
+API void
+SlabFreePages_(void* ptr, intz size)
+{
+	Trace();
+	OsRelease_(ptr, size);
+}
+
+//~ NOTE(ljre): Thread caching heap
+static inline void
+ThreadHeapLock_(ThreadCachingHeap* heap)
+{
+	for (;;)
+	{
+		int32 expected = 0;
+		if (AtomicCompareExchange32Acq(&heap->lock, &expected, 1))
+			break;
+		AtomicPause();
+	}
+}
+
+static inline void
+ThreadHeapUnlock_(ThreadCachingHeap* heap)
+{ AtomicStore32Rel(&heap->lock, 0); }
+
+static inline bool
+ThreadHeapIsSmall_(ThreadCachingHeap* heap, void* ptr)
+{
+	uint8* memory = heap->spans.base.memory;
+	return (uint8*)ptr >= memory && (uint8*)ptr < memory + heap->spans.base.reserved;
+}
+
+static inline ThreadHeapSpan*
+ThreadHeapSpanFromPtr_(void* ptr)
+{ return (ThreadHeapSpan*)((uintptr)ptr & ~(uintptr)(CONFIG_THREAD_HEAP_SPAN_SIZE-1)); }
+
+static inline ThreadHeapCache*
+ThreadHeapFindCache_(ThreadCachingHeap* heap)
+{
+	ThreadHeapCache* cache = ThisThreadContext()->heap_caches;
+	while (cache && cache->heap != heap)
+		cache = cache->next;
+	return cache;
+}
+
+static ThreadHeapCache*
+ThreadHeapCreateCache_(ThreadCachingHeap* heap)
+{
+	Trace();
+	ThreadHeapLock_(heap);
+	ThreadHeapCache* cache = heap->free_caches;
+	if (cache)
+		heap->free_caches = cache->next;
+	else
+		cache = (ThreadHeapCache*)TlsfHeapAlloc(&heap->large, SignedSizeof(ThreadHeapCache), alignof(ThreadHeapCache));
+	if (cache)
+		heap->live_caches += 1;
+	ThreadHeapUnlock_(heap);
+	
+	if (!cache)
+		return NULL;
+	
+	ThreadContext* thread_context = ThisThreadContext();
+	MemoryZero(cache, SignedSizeof(*cache));
+	cache->heap = heap;
+	cache->next = thread_context->heap_caches;
+	thread_context->heap_caches = cache;
+	return cache;
+}
+
+static inline void*
+ThreadHeapSpanPop_(ThreadHeapSpan* span)
+{
+	void* result = span->free_list;
+	
+	if (result)
+		span->free_list = *(void**)result;
+	else if (span->end - span->bump >= span->object_size)
+	{
+		result = span->bump;
+		span->bump += span->object_size;
+	}
+	
+	return result;
+}
+
+// NOTE(ljre): Only called by the owner, and only when the local free list is empty.
+static inline void
+ThreadHeapCollectRemoteFrees_(ThreadHeapSpan* span)
+{
+	if (AtomicLoadPtrRelaxed(&span->remote_free))
+		span->free_list = AtomicExchangePtrAcq(&span->remote_free, NULL);
+}
+
+static void*
+ThreadHeapAllocSlow_(ThreadCachingHeap* heap, ThreadHeapCache* cache, int32 size_class)
+{
+	Trace();
+	ThreadHeapSpan* span;
+	
+	// NOTE(ljre): Move the spans that ran out of room to the full list, taking back remote frees on the way.
+	while ((span = cache->available[size_class]))
+	{
+		if (!span->free_list)
+			ThreadHeapCollectRemoteFrees_(span);
+		void* result = ThreadHeapSpanPop_(span);
+		if (result)
+			return result;
+		
+		cache->available[size_class] = span->next;
+		span->next = cache->full[size_class];
+		cache->full[size_class] = span;
+	}
+	
+	// NOTE(ljre): Before asking for a new span, check whether anything was freed into the full ones. This
+	//             walks every full span, but it only happens once per span's worth of allocations.
+	for (ThreadHeapSpan** it = &cache->full[size_class]; (span = *it);)
+	{
+		if (!span->free_list)
+			ThreadHeapCollectRemoteFrees_(span);
+		if (span->free_list)
+		{
+			*it = span->next;
+			span->next = cache->available[size_class];
+			cache->available[size_class] = span;
+		}
+		else
+			it = &span->next;
+	}
+	
+	// NOTE(ljre): Adopt the spans of threads that are gone, then carve new ones.
+	while (!cache->available[size_class])
+	{
+		ThreadHeapLock_(heap);
+		span = heap->abandoned[size_class];
+		if (span)
+			heap->abandoned[size_class] = span->next;
+		ThreadHeapUnlock_(heap);
+		
+		if (span)
+		{
+			AtomicStorePtrRelaxed(&span->owner, cache);
+			if (!span->free_list)
+				ThreadHeapCollectRemoteFrees_(span);
+		}
+		else
+		{
+			span = (ThreadHeapSpan*)ConcurrentArenaPushDirty(&heap->spans, CONFIG_THREAD_HEAP_SPAN_SIZE);
+			if (!span)
+				return NULL;
+			
+			span->free_list = NULL;
+			span->bump = (uint8*)AlignUp((uintptr)(span + 1), THREAD_HEAP_SMALL_ALIGNMENT-1);
+			span->end = (uint8*)span + CONFIG_THREAD_HEAP_SPAN_SIZE;
+			span->size_class = size_class;
+			span->object_size = (int32)ThreadHeapSizeFromClass(size_class);
+			AtomicStorePtrRelaxed(&span->remote_free, NULL);
+			AtomicStorePtrRelaxed(&span->owner, cache);
+		}
+		
+		bool has_room = (span->free_list || span->end - span->bump >= span->object_size);
+		ThreadHeapSpan** list = has_room ? &cache->available[size_class] : &cache->full[size_class];
+		span->next = *list;
+		*list = span;
+	}
+	
+	return ThreadHeapSpanPop_(cache->available[size_class]);
+}
+
+API bool
+ThreadCachingHeapInit(ThreadCachingHeap* heap, intz reserve_size)
+{
+	Trace();
+	SafeAssert(reserve_size > 0 && reserve_size <= INTZ_MAX - CONFIG_THREAD_HEAP_SPAN_SIZE);
+	MemoryZero(heap, SignedSizeof(*heap));
+	
+	Arena spans = ArenaReserve(reserve_size + CONFIG_THREAD_HEAP_SPAN_SIZE, CONFIG_THREAD_HEAP_SPAN_SIZE);
+	if (!spans.memory)
+		return false;
+	
+	Arena large_arena = ArenaReserve(reserve_size, 0);
+	if (!large_arena.memory)
+	{
+		ArenaRelease(&spans);
+		return false;
+	}
+	
+	// NOTE(ljre): Spans are aligned to their size, so the span of a small object is found by masking its
+	//             address. Nothing else is pushed into this arena, so they stay aligned.
+	spans.offset = (intz)(AlignUp((uintptr)spans.memory, CONFIG_THREAD_HEAP_SPAN_SIZE-1) - (uintptr)spans.memory);
+	
+	heap->spans = ConcurrentArenaFromArena(spans);
+	heap->large_arena = large_arena;
+	heap->large = TlsfHeapCreate(&heap->large_arena, 0);
+	return true;
+}
+
+API void
+ThreadCachingHeapRelease(ThreadCachingHeap* heap)
+{
+	Trace();
+	// NOTE(ljre): Other threads' caches would be left dangling in their ThreadContexts.
+	ThreadCachingHeapReleaseThreadCache(heap);
+	SafeAssert(heap->live_caches == 0);
+	
+	ArenaRelease(&heap->spans.base);
+	ArenaRelease(&heap->large_arena);
+	MemoryZero(heap, SignedSizeof(*heap));
+}
+
+API void*
+ThreadCachingHeapAlloc(ThreadCachingHeap* heap, intz size, intz alignment)
+{
+	SafeAssert(size >= 0);
+	Assert(alignment > 0 && IsPowerOf2(alignment));
+	
+	if (size > THREAD_HEAP_MAX_SMALL_SIZE || alignment > THREAD_HEAP_SMALL_ALIGNMENT)
+	{
+		ThreadHeapLock_(heap);
+		void* result = TlsfHeapAlloc(&heap->large, size, alignment);
+		ThreadHeapUnlock_(heap);
+		return result;
+	}
+	
+	ThreadHeapCache* cache = ThreadHeapFindCache_(heap);
+	if (Unlikely(!cache))
+	{
+		cache = ThreadHeapCreateCache_(heap);
+		if (!cache)
+			return NULL;
+	}
+	
+	int32 size_class = ThreadHeapSizeClass(size);
+	ThreadHeapSpan* span = cache->available[size_class];
+	void* result = span ? ThreadHeapSpanPop_(span) : NULL;
+	if (Unlikely(!result))
+		result = ThreadHeapAllocSlow_(heap, cache, size_class);
+	
+	return result;
+}
+
+API void
+ThreadCachingHeapFree(ThreadCachingHeap* heap, void* ptr)
+{
+	if (!ptr)
+		return;
+	
+	if (!ThreadHeapIsSmall_(heap, ptr))
+	{
+		ThreadHeapLock_(heap);
+		TlsfHeapFree(&heap->large, ptr);
+		ThreadHeapUnlock_(heap);
+		return;
+	}
+	
+	ThreadHeapSpan* span = ThreadHeapSpanFromPtr_(ptr);
+	ThreadHeapCache* owner = (ThreadHeapCache*)AtomicLoadPtrRelaxed(&span->owner);
+	
+	if (owner && owner == ThreadHeapFindCache_(heap))
+	{
+		*(void**)ptr = span->free_list;
+		span->free_list = ptr;
+	}
+	else
+	{
+		void* head = AtomicLoadPtrRelaxed(&span->remote_free);
+		do
+			*(void**)ptr = head;
+		while (!AtomicCompareExchangePtrRel(&span->remote_free, &head, ptr));
+	}
+}
+
+API void*
+ThreadCachingHeapResize(ThreadCachingHeap* heap, void* ptr, intz old_size, intz size, intz alignment)
+{
+	SafeAssert(size >= 0 && old_size >= 0);
+	Assert(alignment > 0 && IsPowerOf2(alignment));
+	
+	if (!ptr)
+		return ThreadCachingHeapAlloc(heap, size, alignment);
+	
+	if (!ThreadHeapIsSmall_(heap, ptr))
+	{
+		ThreadHeapLock_(heap);
+		void* result = TlsfHeapResize(&heap->large, ptr, size, alignment);
+		ThreadHeapUnlock_(heap);
+		return result;
+	}
+	
+	ThreadHeapSpan* span = ThreadHeapSpanFromPtr_(ptr);
+	if (size <= span->object_size && alignment <= THREAD_HEAP_SMALL_ALIGNMENT)
+		return ptr;
+	
+	void* result = ThreadCachingHeapAlloc(heap, size, alignment);
+	if (result)
+	{
+		MemoryCopy(result, ptr, Min(old_size, size));
+		ThreadCachingHeapFree(heap, ptr);
+	}
+	
+	return result;
+}
+
+// NOTE(ljre): Small objects aren't counted one by one (that would need atomics on every free), so every
+//             span handed out counts as used.
+API void
+ThreadCachingHeapQueryInfo(ThreadCachingHeap* heap, AllocatorInfo* out_info)
+{
+	Trace();
+	ThreadHeapLock_(heap);
+	intz large_used = heap->large.used;
+	intz large_committed = heap->large_arena.size;
+	ThreadHeapUnlock_(heap);
+	
+	out_info->used = (intz)AtomicLoad64Relaxed(&heap->spans.offset) - heap->spans.base.offset + large_used;
+	out_info->committed = (intz)AtomicLoad64Relaxed(&heap->spans.committed) + large_committed;
+	out_info->reserved = heap->spans.base.reserved + heap->large_arena.reserved;
+	out_info->thread_safe = true;
+}
+
+API bool
+ThreadCachingHeapSetBudget(ThreadCachingHeap* heap, MemoryBudget* budget)
+{
+	Trace();
+	// NOTE(ljre): Both arenas commit under a lock, so take it while their budget changes.
+	for (;;)
+	{
+		int32 expected = 0;
+		if (AtomicCompareExchange32Acq(&heap->spans.commit_lock, &expected, 1))
+			break;
+		AtomicPause();
+	}
+	bool ok = ArenaSetBudget(&heap->spans.base, budget);
+	AtomicStore32Rel(&heap->spans.commit_lock, 0);
+	
+	if (ok)
+	{
+		ThreadHeapLock_(heap);
+		ok = ArenaSetBudget(&heap->large_arena, budget);
+		ThreadHeapUnlock_(heap);
+	}
+	
+	return ok;
+}
+
+API void
+ThreadCachingHeapReleaseThreadCache(ThreadCachingHeap* heap)
+{
+	Trace();
+	ThreadContext* thread_context = ThisThreadContext();
+	ThreadHeapCache** it = &thread_context->heap_caches;
+	while (*it && (*it)->heap != heap)
+		it = &(*it)->next;
+	
+	ThreadHeapCache* cache = *it;
+	if (!cache)
+		return;
+	*it = cache->next;
+	
+	ThreadHeapLock_(heap);
+	for (int32 i = 0; i < THREAD_HEAP_CLASS_COUNT; ++i)
+	{
+		ThreadHeapSpan* lists[] = { cache->available[i], cache->full[i] };
+		for (intz j = 0; j < ArrayLength(lists); ++j)
+		{
+			for (ThreadHeapSpan* span = lists[j]; span;)
+			{
+				ThreadHeapSpan* next = span->next;
+				AtomicStorePtrRelaxed(&span->owner, NULL);
+				span->next = heap->abandoned[i];
+				heap->abandoned[i] = span;
+				span = next;
+			}
+		}
+	}
+	cache->next = heap->free_caches;
+	heap->free_caches = cache;
+	heap->live_caches -= 1;
+	ThreadHeapUnlock_(heap);
+}
+
 static inline intz StringPrintfFunc_(char* buf, intz buf_size, const char* restrict fmt, va_list args);
 
 API FORCE_NOINLINE intz
@@ -218,8 +218,51 @@ struct Range
 typedef Range;
 
 struct Arena typedef Arena;
+struct MemoryBudget typedef MemoryBudget;
 typedef bool ArenaCommitMemoryProc(Arena* arena, intz needed_size);
 
+enum ArenaFlags
+{
+	// NOTE(ljre): Shrinking the arena (ArenaPop, ArenaRestore, ArenaClear) gives committed memory back.
+	//             See ArenaSetDecommitPolicy().
+	ArenaFlags_Decommit = 1 << 0,
+	// NOTE(ljre): Decommitted pages are only lazily reclaimed by the OS (MADV_FREE where available).
+	ArenaFlags_LazyDecommit = 1 << 1,
+	// NOTE(ljre): The arena is a chain of blocks (see ArenaChained()). 'memory' points to the ArenaBlock
+	//             header of the current block, and 'size'/'offset' are relative to it.
+	ArenaFlags_Chained = 1 << 2,
+	// NOTE(ljre): Reserve with MAP_HUGETLB when possible, falling back to MADV_HUGEPAGE otherwise.
+	//             Only meaningful as a creation flag for ArenaReserveEx().
+	ArenaFlags_HugePages = 1 << 3,
+	// NOTE(ljre): The arena is a MAP_SHARED view of the file in 'fd', which is grown with ftruncate() as
+	//             the arena commits. See ArenaFromFile() and ArenaFromMemfd().
+	ArenaFlags_FileBacked = 1 << 4,
+	// NOTE(ljre): Prefer placing the arena's pages on the NUMA node in ArenaReserveDesc::numa_node, no
+	//             matter which thread touches them first. Only meaningful as a creation flag for
+	//             ArenaReserveEx(), and ignored where NUMA policies aren't supported.
+	ArenaFlags_NumaNode = 1 << 5,
+}
+typedef ArenaFlags;
+
+// NOTE(ljre): Only tracked when CONFIG_ARENA_STATS is defined.
+struct ArenaStats
+{
+	intz peak_offset;
+	int64 push_count;
+	int64 padding_bytes; // lost to alignment in ArenaPushDirtyAligned()
+	int64 commit_count;  // calls to commit_memory_proc()
+	int64 commit_nanoseconds;
+}
+typedef ArenaStats;
+
+struct ArenaBlock typedef ArenaBlock;
+struct ArenaBlock
+{
+	ArenaBlock* prev; // next free block when in the free list
+	intz prev_offset;
+	intz size;
+};
+
 struct Arena
 {
 	intz size;
@@ -227,15 +270,36 @@ struct Arena
 	uint8* memory;
 	
 	// NOTE(ljre): Commit-as-you-go arena style.
-	//             commit_memory_proc() function should return true if the specified needed_size is commited
+	//             commit_memory_proc() function should return true if the specified needed_size is commited.
+	//             If needed_size is less than size, it may decommit the memory past needed_size.
 	intz reserved;
+	intz commit_granularity;
 	ArenaCommitMemoryProc* commit_memory_proc;
+	
+	uint32 flags; // ArenaFlags
+	intz decommit_high_water;
+	intz decommit_hysteresis;
+	
+	// NOTE(ljre): Chained arenas only. Popped blocks go to free_blocks to be reused later.
+	intz block_size;
+	ArenaBlock* free_blocks;
+	
+	// NOTE(ljre): File backed arenas only.
+	int32 fd;
+	
+	// NOTE(ljre): Charged for committed memory when set. See ArenaSetBudget() and base_budget.h.
+	MemoryBudget* budget;
+	
+#ifdef CONFIG_ARENA_STATS
+	ArenaStats stats;
+#endif
 };
 
 struct ArenaSavepoint
 {
 	Arena* arena;
 	intz offset;
+	uint8* memory;
 }
 typedef ArenaSavepoint;
 
@@ -250,8 +314,10 @@ enum AllocatorMode
 	// requires (size, alignment, old_ptr, old_size), returns a valid pointer
 	AllocatorMode_Resize,
 	// requires(old_ptr), returns NULL
-	// NOTE(ljre): old_ptr needs to be a valid pointer to a uint32
+	// NOTE(ljre): old_ptr needs to be a valid pointer to a uint32, which receives AllocatorFeature flags
 	AllocatorMode_QueryFeatures,
+	// requires(old_ptr), returns NULL
+	// NOTE(ljre): old_ptr needs to be a valid pointer to an AllocatorInfo
 	AllocatorMode_QueryInfo,
 	// same as Alloc
 	AllocatorMode_AllocNonZeroed,
@@ -262,9 +328,43 @@ enum AllocatorMode
 	//             to the end of the arena and then call Pop(ptr) to free all allocations made after the
 	//             call to Alloc.
 	AllocatorMode_Pop,
+	// requires (size, alignment, old_ptr, old_size), returns old_ptr
+	// NOTE(ljre): old_ptr needs to be a valid pointer to an array of old_size void*s, which receives that
+	//             many zeroed allocations of the same size and alignment. On failure, nothing is allocated.
+	AllocatorMode_AllocBatch,
+	// requires (size, alignment, old_ptr, old_size), returns NULL
+	// NOTE(ljre): old_ptr needs to be a valid pointer to an array of old_size void*s, all of them allocated
+	//             with the same size and alignment. Like with Free, NULL entries are ignored. alignment can
+	//             be 0 if it isn't known, but arenas then only give back what ends exactly at their tip.
+	AllocatorMode_FreeBatch,
 }
 typedef AllocatorMode;
 
+// NOTE(ljre): There's one flag for each mode an allocator implements, plus flags describing how they behave.
+enum AllocatorFeature
+{
+	AllocatorFeature_Alloc           = 1 << AllocatorMode_Alloc,
+	AllocatorFeature_Free            = 1 << AllocatorMode_Free,
+	AllocatorFeature_FreeAll         = 1 << AllocatorMode_FreeAll,
+	AllocatorFeature_Resize          = 1 << AllocatorMode_Resize,
+	AllocatorFeature_QueryFeatures   = 1 << AllocatorMode_QueryFeatures,
+	AllocatorFeature_QueryInfo       = 1 << AllocatorMode_QueryInfo,
+	AllocatorFeature_AllocNonZeroed  = 1 << AllocatorMode_AllocNonZeroed,
+	AllocatorFeature_ResizeNonZeroed = 1 << AllocatorMode_ResizeNonZeroed,
+	AllocatorFeature_Pop             = 1 << AllocatorMode_Pop,
+	AllocatorFeature_AllocBatch      = 1 << AllocatorMode_AllocBatch,
+	AllocatorFeature_FreeBatch       = 1 << AllocatorMode_FreeBatch,
+
+	// Free only gives memory back in special cases (e.g. the last allocation of an arena), so callers that
+	// will FreeAll/Pop later anyway can skip it.
+	AllocatorFeature_FreeIsOptional  = 1 << 24,
+	// Resize may grow an allocation without moving it.
+	AllocatorFeature_ResizeInPlace   = 1 << 25,
+	// Alloc, Resize and Free can be called from many threads at once.
+	AllocatorFeature_ThreadSafe      = 1 << 26,
+}
+typedef AllocatorFeature;
+
 enum AllocatorError
 {
 	AllocatorError_Ok = 0,
@@ -275,6 +375,16 @@ enum AllocatorError
 }
 typedef AllocatorError;
 
+// NOTE(ljre): Filled in by AllocatorMode_QueryInfo. All sizes are in bytes.
+struct AllocatorInfo
+{
+	intz used;      // handed out to callers, not counting headers or padding
+	intz committed; // backed by memory
+	intz reserved;  // address space held, committed or not
+	bool thread_safe;
+}
+typedef AllocatorInfo;
+
 struct Allocator typedef Allocator;
 typedef void* AllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err);
 struct Allocator
@@ -310,36 +420,59 @@ struct ThreadContextLogger
 
 typedef void ThreadContextAssertionFailureProc(String expr, String func, String file, int32 line);
 
+struct ThreadHeapCache typedef ThreadHeapCache;
+
+#ifndef CONFIG_SCRATCH_ARENA_COUNT
+#	define CONFIG_SCRATCH_ARENA_COUNT 2
+#endif
+
+#ifndef CONFIG_SCRATCH_ARENA_DEFAULT_SIZE
+#	define CONFIG_SCRATCH_ARENA_DEFAULT_SIZE (64 << 20)
+#endif
+
+static_assert(CONFIG_SCRATCH_ARENA_COUNT >= 1 && CONFIG_SCRATCH_ARENA_COUNT <= 32, "scratch arenas are tracked in a 32-bit mask");
+
 struct ThreadContext
 {
-	Arena scratch[2]; // 4 MiB each
+	// NOTE(ljre): Reserved on first use by ScratchArena(), and committed as they grow. Set
+	//             scratch_reserve_size before that to change their size (0 for the default).
+	Arena scratch[CONFIG_SCRATCH_ARENA_COUNT];
+	intz scratch_reserve_size;
 	ThreadContextLogger logger;
 	ThreadContextAssertionFailureProc* assertion_failure_proc;
+	ThreadHeapCache* heap_caches; // see base_thread_heap.h
 }
 typedef ThreadContext;
 
 API ThreadContext* ThisThreadContext(void);
+API void           ThreadContextReserveScratch_(Arena* arena);
+API void           ThreadContextReleaseScratch(void); // call before a thread that used ScratchArena() exits
+
+static inline FORCE_INLINE int32 BitCtz32(uint32 i); // see base_intrinsics.h
 
+// NOTE(ljre): Returns the first scratch arena that isn't in 'conflicts', or NULL if all of them are.
+//             Conflicts are turned into a bitmask of taken arenas and the lowest clear bit is picked, so it
+//             costs one check per conflict no matter how many arenas there are.
 static inline Arena*
 ScratchArena(intz conflict_count, Arena* const conflicts[])
 {
 	ThreadContext* thread_context = ThisThreadContext();
-	for (intz i = 0; i < ArrayLength(thread_context->scratch); ++i)
+	uint32 taken = 0;
+	for (intz i = 0; i < conflict_count; ++i)
 	{
-		Arena* arena = &thread_context->scratch[i];
-		bool ok = true;
-		for (intz j = 0; j < conflict_count; ++j)
-		{
-			if (arena == conflicts[j])
-			{
-				ok = false;
-				break;
-			}
-		}
-		if (ok)
-			return arena;
+		uintptr offset = (uintptr)conflicts[i] - (uintptr)thread_context->scratch;
+		if (offset < sizeof(thread_context->scratch))
+			taken |= (uint32)1 << (offset / sizeof(Arena));
 	}
-	return NULL;
+	
+	int32 index = BitCtz32(~taken);
+	if (Unlikely(index >= CONFIG_SCRATCH_ARENA_COUNT))
+		return NULL;
+	
+	Arena* arena = &thread_context->scratch[index];
+	if (Unlikely(!arena->memory))
+		ThreadContextReserveScratch_(arena);
+	return arena;
 }
 
 static inline void
@@ -404,6 +537,8 @@ AssertionFailure(char const* expr, char const* func, char const* file, int32 lin
 #define StrMacro(x) StrMacro_(x)
 
 #ifdef __cplusplus
+#include "base_assert.h"
+
 template <typename T>
 struct Slice
 {
@@ -421,7 +556,7 @@ struct Slice
 	inline T* begin() const { return data; }
 	inline T* end() const { return data + count; }
 	inline intz Size() const { return count * SignedSizeof(T); }
-	inline Buffer Buffer() const
+	inline ::Buffer Buffer() const
 	{
 		SafeAssert(count <= INTZ_MAX / sizeof(T));
 		return { (uint8 const*)data, count * SignedSizeof(T) };
@@ -485,4 +620,6 @@ SliceFromTypedBuffer(Buffer buf)
 }
 #endif
 
+#include "base_intrinsics.h"
+
 #endif
\ No newline at end of file
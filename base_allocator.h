@@ -16,6 +16,11 @@ static inline void   AllocatorFreeString       (Allocator allocator, String str,
 static inline void   AllocatorFreeBuffer       (Allocator allocator, Buffer buf, AllocatorError* out_err);
 static inline void   AllocatorFreeAll          (Allocator allocator, AllocatorError* out_err);
 static inline void   AllocatorPop              (Allocator allocator, void* old_ptr, AllocatorError* out_err);
+static inline bool   AllocatorAllocBatch       (Allocator allocator, intz size, intz alignment, void** out_ptrs, intz count, AllocatorError* out_err);
+static inline void   AllocatorFreeBatch        (Allocator allocator, intz size, intz alignment, void** ptrs, intz count, AllocatorError* out_err);
+static inline uint32 AllocatorQueryFeatures    (Allocator allocator, AllocatorError* out_err);
+static inline bool   AllocatorHasFeatures      (Allocator allocator, uint32 features);
+static inline AllocatorInfo AllocatorQueryInfo (Allocator allocator, AllocatorError* out_err);
 static inline bool   AllocatorResizeOk         (Allocator allocator, intz size, intz alignment, void* inout_ptr, intz old_size, AllocatorError* out_err);
 static inline bool   AllocatorResizeNonZeroedOk(Allocator allocator, intz size, intz alignment, void* inout_ptr, intz old_size, AllocatorError* out_err);
 static inline void*  AllocatorAllocArray       (Allocator allocator, intz count, intz size, intz alignment, AllocatorError* out_err);
@@ -106,6 +111,83 @@ AllocatorPop(Allocator allocator, void* old_ptr, AllocatorError* out_err)
 	allocator.proc(allocator.instance, AllocatorMode_Pop, 0, 0, old_ptr, 0, out_err);
 }
 
+// NOTE(ljre): Falls back to one Alloc per pointer if the allocator doesn't implement AllocBatch.
+static inline bool
+AllocatorAllocBatch(Allocator allocator, intz size, intz alignment, void** out_ptrs, intz count, AllocatorError* out_err)
+{
+	AllocatorError error;
+	allocator.proc(allocator.instance, AllocatorMode_AllocBatch, size, alignment, out_ptrs, count, &error);
+
+	if (error == AllocatorError_ModeNotImplemented)
+	{
+		error = AllocatorError_Ok;
+		intz i = 0;
+		for (; i < count && !error; ++i)
+			out_ptrs[i] = allocator.proc(allocator.instance, AllocatorMode_Alloc, size, alignment, NULL, 0, &error);
+
+		if (error)
+		{
+			AllocatorError ignored;
+			for (i -= 1; i > 0; --i)
+				allocator.proc(allocator.instance, AllocatorMode_Free, 0, 0, out_ptrs[i-1], size, &ignored);
+		}
+	}
+
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+	return error == AllocatorError_Ok;
+}
+
+// NOTE(ljre): Falls back to one Free per pointer if the allocator doesn't implement FreeBatch.
+static inline void
+AllocatorFreeBatch(Allocator allocator, intz size, intz alignment, void** ptrs, intz count, AllocatorError* out_err)
+{
+	AllocatorError error;
+	allocator.proc(allocator.instance, AllocatorMode_FreeBatch, size, alignment, ptrs, count, &error);
+
+	if (error == AllocatorError_ModeNotImplemented)
+	{
+		error = AllocatorError_Ok;
+		for (intz i = 0; i < count && !error; ++i)
+			allocator.proc(allocator.instance, AllocatorMode_Free, 0, 0, ptrs[i], size, &error);
+	}
+
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+}
+
+static inline uint32
+AllocatorQueryFeatures(Allocator allocator, AllocatorError* out_err)
+{
+	uint32 features = 0;
+	allocator.proc(allocator.instance, AllocatorMode_QueryFeatures, 0, 0, &features, 0, out_err);
+	return features;
+}
+
+// NOTE(ljre): Doesn't trap. Allocators that can't be queried simply don't have any feature.
+static inline bool
+AllocatorHasFeatures(Allocator allocator, uint32 features)
+{
+	if (!allocator.proc)
+		return false;
+
+	AllocatorError error;
+	uint32 supported = AllocatorQueryFeatures(allocator, &error);
+	return error == AllocatorError_Ok && (supported & features) == features;
+}
+
+static inline AllocatorInfo
+AllocatorQueryInfo(Allocator allocator, AllocatorError* out_err)
+{
+	AllocatorInfo info = {};
+	allocator.proc(allocator.instance, AllocatorMode_QueryInfo, 0, 0, &info, 0, out_err);
+	return info;
+}
+
 static inline bool
 AllocatorResizeOk(Allocator allocator, intz size, intz alignment, void* inout_ptr, intz old_size, AllocatorError* out_err)
 {
@@ -186,7 +268,7 @@ AllocatorPrintf(Allocator allocator, AllocatorError* out_err, char const* fmt, .
 	intz size = StringVPrintfSize(fmt, args);
 	va_end(args);
 
-	char* buf = allocator.proc(allocator.instance, AllocatorMode_Alloc, size, 1, NULL, 0, out_err);
+	char* buf = (char*)allocator.proc(allocator.instance, AllocatorMode_Alloc, size, 1, NULL, 0, out_err);
 	if (buf)
 	{
 		va_start(args, fmt);
@@ -207,7 +289,7 @@ AllocatorVPrintf(Allocator allocator, AllocatorError* out_err, char const* fmt,
 	intz size = StringVPrintfSize(fmt, args2);
 	va_end(args2);
 
-	char* buf = allocator.proc(allocator.instance, AllocatorMode_Alloc, size, 1, NULL, 0, out_err);
+	char* buf = (char*)allocator.proc(allocator.instance, AllocatorMode_Alloc, size, 1, NULL, 0, out_err);
 	if (buf)
 		str = StringVPrintf(buf, size, fmt, args);
 	
@@ -215,51 +297,76 @@ AllocatorVPrintf(Allocator allocator, AllocatorError* out_err, char const* fmt,
 }
 
 #ifdef __cplusplus
-template <typename T>
+// NOTE(ljre): The templates below take any allocator type A for which there's an AllocatorCall_() overload:
+//             - Allocator calls through the proc pointer, for runtime polymorphism;
+//             - StaticAllocator<Proc> calls Proc directly, so the compiler can inline it and fold the mode;
+//             - Arena* (see base_arena.h) goes straight to the inline arena push functions.
+template <AllocatorProc* Proc>
+struct StaticAllocator
+{
+	void* instance;
+
+	inline operator Allocator() const { return { Proc, instance }; }
+};
+
+static inline FORCE_INLINE void*
+AllocatorCall_(Allocator allocator, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	return allocator.proc(allocator.instance, mode, size, alignment, old_ptr, old_size, out_err);
+}
+
+template <AllocatorProc* Proc>
+static inline FORCE_INLINE void*
+AllocatorCall_(StaticAllocator<Proc> allocator, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	return Proc(allocator.instance, mode, size, alignment, old_ptr, old_size, out_err);
+}
+
+template <typename T, typename A>
 static inline T*
-AllocatorNew(Allocator allocator, AllocatorError* out_err)
+AllocatorNew(A allocator, AllocatorError* out_err)
 {
-	return (T*)allocator.proc(allocator.instance, AllocatorMode_Alloc, SignedSizeof(T), alignof(T), NULL, 0, out_err);
+	return (T*)AllocatorCall_(allocator, AllocatorMode_Alloc, SignedSizeof(T), alignof(T), NULL, 0, out_err);
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline T*
-AllocatorNewArray(Allocator allocator, intz count, AllocatorError* out_err)
+AllocatorNewArray(A allocator, intz count, AllocatorError* out_err)
 {
 	SafeAssert(count >= 0 && count <= INTZ_MAX / sizeof(T));
-	return (T*)allocator.proc(allocator.instance, AllocatorMode_Alloc, count*SignedSizeof(T), alignof(T), NULL, 0, out_err);
+	return (T*)AllocatorCall_(allocator, AllocatorMode_Alloc, count*SignedSizeof(T), alignof(T), NULL, 0, out_err);
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline void
-AllocatorDelete(Allocator allocator, T* ptr, AllocatorError* out_err)
+AllocatorDelete(A allocator, T* ptr, AllocatorError* out_err)
 {
-	allocator.proc(allocator.instance, AllocatorMode_Free, 0, 0, ptr, SignedSizeof(T), out_err);
+	AllocatorCall_(allocator, AllocatorMode_Free, 0, 0, ptr, SignedSizeof(T), out_err);
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline void
-AllocatorDeleteArray(Allocator allocator, T* ptr, intz count, AllocatorError* out_err)
+AllocatorDeleteArray(A allocator, T* ptr, intz count, AllocatorError* out_err)
 {
 	SafeAssert(count >= 0 && count <= INTZ_MAX / sizeof(T));
-	allocator.proc(allocator.instance, AllocatorMode_Free, 0, 0, ptr, count*SignedSizeof(T), out_err);
+	AllocatorCall_(allocator, AllocatorMode_Free, 0, 0, ptr, count*SignedSizeof(T), out_err);
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline T*
-AllocatorResizeArray(Allocator allocator, intz count, T* ptr, intz old_count, AllocatorError* out_err)
+AllocatorResizeArray(A allocator, intz count, T* ptr, intz old_count, AllocatorError* out_err)
 {
 	SafeAssert(count >= 0 && count <= INTZ_MAX / sizeof(T));
 	SafeAssert(old_count >= 0 && old_count <= INTZ_MAX / sizeof(T));
-	return (T*)allocator.proc(allocator.instance, AllocatorMode_Resize, count * SignedSizeof(T), alignof(T), ptr, old_count * SignedSizeof(T), out_err);
+	return (T*)AllocatorCall_(allocator, AllocatorMode_Resize, count * SignedSizeof(T), alignof(T), ptr, old_count * SignedSizeof(T), out_err);
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline bool
-AllocatorResizeArrayOk(Allocator allocator, intz count, T** ptr, intz old_count, AllocatorError* out_err)
+AllocatorResizeArrayOk(A allocator, intz count, T** ptr, intz old_count, AllocatorError* out_err)
 {
 	SafeAssert(count >= 0 && count <= INTZ_MAX / sizeof(T));
-	T* result = (T*)allocator.proc(allocator.instance, AllocatorMode_Resize, count * SignedSizeof(T), alignof(T), ptr, old_count * SignedSizeof(T), out_err);
+	T* result = (T*)AllocatorCall_(allocator, AllocatorMode_Resize, count * SignedSizeof(T), alignof(T), *ptr, old_count * SignedSizeof(T), out_err);
 	if (result || !count)
 	{
 		*ptr = result;
@@ -268,44 +375,44 @@ AllocatorResizeArrayOk(Allocator allocator, intz count, T** ptr, intz old_count,
 	return false;
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline Slice<T>
-AllocatorNewSlice(Allocator allocator, intz count, AllocatorError* out_err)
+AllocatorNewSlice(A allocator, intz count, AllocatorError* out_err)
 {
 	SafeAssert(count >= 0 && count <= INTZ_MAX / sizeof(T));
-	T* ptr = (T*)allocator.proc(allocator.instance, AllocatorMode_Alloc, count*SignedSizeof(T), alignof(T), NULL, 0, out_err);
+	T* ptr = (T*)AllocatorCall_(allocator, AllocatorMode_Alloc, count*SignedSizeof(T), alignof(T), NULL, 0, out_err);
 	if (ptr)
 		return { ptr, count };
 	return {};
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline void
-AllocatorDeleteSlice(Allocator allocator, Slice<T> slice, AllocatorError* out_err)
+AllocatorDeleteSlice(A allocator, Slice<T> slice, AllocatorError* out_err)
 {
 	SafeAssert(slice.count >= 0 && slice.count <= INTZ_MAX / sizeof(T));
-	allocator.proc(allocator.instance, AllocatorMode_Free, 0, 0, slice.data, slice.count*SignedSizeof(T), out_err);
+	AllocatorCall_(allocator, AllocatorMode_Free, 0, 0, slice.data, slice.count*SignedSizeof(T), out_err);
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline Slice<T>
-AllocatorResizeSlice(Allocator allocator, intz count, Slice<T> slice, AllocatorError* out_err)
+AllocatorResizeSlice(A allocator, intz count, Slice<T> slice, AllocatorError* out_err)
 {
 	SafeAssert(count >= 0 && count <= INTZ_MAX / sizeof(T));
 	SafeAssert(slice.count >= 0 && slice.count <= INTZ_MAX / sizeof(T));
-	T* ptr = (T*)allocator.proc(allocator.instance, AllocatorMode_Resize, count * SignedSizeof(T), alignof(T), slice.data, slice.count * SignedSizeof(T), out_err);
+	T* ptr = (T*)AllocatorCall_(allocator, AllocatorMode_Resize, count * SignedSizeof(T), alignof(T), slice.data, slice.count * SignedSizeof(T), out_err);
 	if (ptr)
 		return { ptr, count };
 	return {};
 }
 
-template <typename T>
+template <typename T, typename A>
 static inline bool
-AllocatorResizeSliceOk(Allocator allocator, intz count, Slice<T>* slice_ptr, AllocatorError* out_err)
+AllocatorResizeSliceOk(A allocator, intz count, Slice<T>* slice_ptr, AllocatorError* out_err)
 {
 	SafeAssert(count >= 0 && count <= INTZ_MAX / sizeof(T));
-	SafeAssert(slice_ptr->count >= 0 && slice_ptr->count <= INTSIZE_MAX / sizeof(T));
-	T* result = (T*)allocator.proc(allocator.instance, AllocatorMode_Resize, count * SignedSizeof(T), alignof(T), slice_ptr->data, slice_ptr->count * SignedSizeof(T), out_err);
+	SafeAssert(slice_ptr->count >= 0 && slice_ptr->count <= INTZ_MAX / sizeof(T));
+	T* result = (T*)AllocatorCall_(allocator, AllocatorMode_Resize, count * SignedSizeof(T), alignof(T), slice_ptr->data, slice_ptr->count * SignedSizeof(T), out_err);
 	if (result || !count)
 	{
 		*slice_ptr = { result, count };
@@ -4,12 +4,23 @@
 #include "base.h"
 #include "base_intrinsics.h"
 #include "base_string.h"
+#include "base_budget.h"
 
 #ifndef CONFIG_ARENA_DEFAULT_ALIGNMENT
 #	define CONFIG_ARENA_DEFAULT_ALIGNMENT 16
 #endif
 
+#ifndef CONFIG_ARENA_DEFAULT_COMMIT_GRANULARITY
+#	define CONFIG_ARENA_DEFAULT_COMMIT_GRANULARITY (64 << 10)
+#endif
+
+#ifndef CONFIG_ARENA_HUGE_PAGE_SIZE
+#	define CONFIG_ARENA_HUGE_PAGE_SIZE (2 << 20)
+#endif
+
 static_assert(CONFIG_ARENA_DEFAULT_ALIGNMENT != 0 && IsPowerOf2(CONFIG_ARENA_DEFAULT_ALIGNMENT), "Default Arena alignment should always be non-zero and a power of two");
+static_assert(CONFIG_ARENA_DEFAULT_COMMIT_GRANULARITY != 0 && IsPowerOf2(CONFIG_ARENA_DEFAULT_COMMIT_GRANULARITY), "Default Arena commit granularity should always be non-zero and a power of two");
+static_assert(CONFIG_ARENA_HUGE_PAGE_SIZE != 0 && IsPowerOf2(CONFIG_ARENA_HUGE_PAGE_SIZE), "Huge page size should always be non-zero and a power of two");
 
 #define ArenaPushStruct(arena, Type) \
 	((Type*)ArenaPushAligned(arena, SignedSizeof(Type), alignof(Type)))
@@ -24,7 +35,7 @@ static_assert(CONFIG_ARENA_DEFAULT_ALIGNMENT != 0 && IsPowerOf2(CONFIG_ARENA_DEF
 #define ArenaPushDataArray(arena, data, count) \
 	MemoryCopy(ArenaPushDirtyAligned(arena, SignedSizeof(*(data))*(count), 1), data, SignedSizeof(*(data))*(count))
 #define ArenaTempScope(arena_) \
-	(ArenaSavepoint _temp__ = { arena_, (arena_)->offset }; _temp__.arena; _temp__.arena->offset = _temp__.offset, _temp__.arena = NULL)
+	(ArenaSavepoint _temp__ = ArenaSave(arena_); _temp__.arena; ArenaRestore(_temp__), _temp__.arena = NULL)
 #ifndef __cplusplus
 #   define ArenaPushStructInit(arena, Type, ...) \
 		((void*)ArenaPushMemoryAligned(arena, &(Type) __VA_ARGS__, SignedSizeof(Type), alignof(Type)))
@@ -56,8 +67,124 @@ static inline void   ArenaClear            (Arena* arena);
 static inline void*  ArenaEnd              (Arena* arena);
 static inline ArenaSavepoint ArenaSave     (Arena* arena);
 static inline void           ArenaRestore  (ArenaSavepoint savepoint);
+static inline void   ArenaSetDecommitPolicy(Arena* arena, intz high_water, intz hysteresis);
+static inline void   ArenaTrim             (Arena* arena);
 
 static inline Allocator AllocatorFromArena(Arena* arena);
+static inline bool      ArenaSetBudget    (Arena* arena, MemoryBudget* budget);
+
+static inline ArenaStats ArenaGetStats       (Arena* arena);
+static inline void       ArenaAccumulateStats(ArenaStats* total, ArenaStats const* stats);
+API           ArenaStats ArenaGetScratchStats(void);
+API           void       ArenaLogStats       (int32 level, char const* name, ArenaStats const* stats);
+
+// NOTE(ljre): Virtual memory arenas. ArenaReserve() reserves address space up front and commits it in
+//             chunks of commit_granularity bytes (0 for the default) as the arena grows.
+//             ArenaChained() instead links a new block of at least block_size bytes whenever the current
+//             one runs out. Memory pushed across a block boundary is not contiguous, so ArenaBeginArray()
+//             and ArenaEndArray() shouldn't be used on those.
+struct ArenaReserveDesc
+{
+	intz reserve_size;
+	intz commit_granularity;
+	uint32 flags; // ArenaFlags
+	MemoryBudget* budget; // optional
+	int32 numa_node; // with ArenaFlags_NumaNode
+}
+typedef ArenaReserveDesc;
+
+// NOTE(ljre): NUMA node of the CPU the calling thread is running on right now, or -1 if unknown. Only
+//             stable if the thread is pinned to that node.
+API int32 ThisThreadNumaNode(void);
+
+API Arena ArenaReserve                (intz reserve_size, intz commit_granularity);
+API Arena ArenaReserveEx              (ArenaReserveDesc const* desc);
+API Arena ArenaChained                (intz block_size);
+API void  ArenaRelease                (Arena* arena);
+API bool  ArenaVirtualCommitMemoryProc(Arena* arena, intz needed_size);
+API void* ArenaPushNewBlock_          (Arena* arena, intz size, intz alignment);
+
+// NOTE(ljre): File backed arenas. The whole reserve_size is mapped MAP_SHARED up front, and committing
+//             grows the file with ftruncate(), so other processes mapping the same file (or memfd) see
+//             the arena's contents as they're written. The file is never shrunk: decommitting punches a
+//             hole in it instead (where supported). ArenaRelease() unmaps and closes the file.
+//
+//             Whatever is already in the file is mapped as committed memory, but the arena still starts
+//             at offset 0. To build on top of existing contents, set 'offset' yourself (from a header
+//             at the start of the file, for example). Pointers into the arena are only valid in the
+//             process that created them, since each mapping lives at a different address.
+//
+//             ArenaFromFd() takes ownership of 'fd', which needs to be open for reading and writing.
+//             ArenaFromMemfd() is Linux only. All of these return an empty arena on failure or on
+//             platforms without support.
+API Arena ArenaFromFd                 (int32 fd, intz reserve_size, intz commit_granularity);
+API Arena ArenaFromFile               (String path, intz reserve_size, intz commit_granularity);
+API Arena ArenaFromMemfd              (String name, intz reserve_size, intz commit_granularity);
+API bool  ArenaFileCommitMemoryProc   (Arena* arena, intz needed_size);
+
+// NOTE(ljre): Copy-on-write snapshot of a file backed arena, for speculative work. The fork's arena maps
+//             the source's committed memory MAP_PRIVATE, so it starts with the same contents without
+//             copying anything, and pages are only copied as the fork writes to them. Anything pushed
+//             past the source's committed size goes to anonymous memory.
+//
+//             ArenaForkDiscard() just unmaps it. ArenaForkCommit() writes the pages the fork changed
+//             (found through /proc/self/pagemap where available, otherwise all of them) back into the
+//             source and moves its offset to the fork's. Either one releases the fork.
+//
+//             The source must not be written to while it has a fork. Forks only work on Linux and with
+//             sources from ArenaFromFile()/ArenaFromMemfd(); ArenaForkBegin() returns false otherwise.
+struct ArenaFork
+{
+	Arena arena;
+	Arena* source;
+	intz shared_size; // bytes mapped from the source's file
+}
+typedef ArenaFork;
+
+API bool ArenaForkBegin  (ArenaFork* fork, Arena* source);
+API bool ArenaForkCommit (ArenaFork* fork);
+API void ArenaForkDiscard(ArenaFork* fork);
+
+#ifdef CONFIG_ARENA_STATS
+API int64 ArenaStatsNanoseconds_(void);
+#endif
+
+static inline bool
+ArenaCommit_(Arena* arena, intz needed_size)
+{
+#ifdef CONFIG_ARENA_STATS
+	int64 begin = ArenaStatsNanoseconds_();
+	bool ok = arena->commit_memory_proc(arena, needed_size);
+	arena->stats.commit_count += 1;
+	arena->stats.commit_nanoseconds += ArenaStatsNanoseconds_() - begin;
+	return ok;
+#else
+	return arena->commit_memory_proc(arena, needed_size);
+#endif
+}
+
+static inline bool
+ArenaBlockContains_(Arena* arena, void const* ptr)
+{
+	uint8 const* p = (uint8 const*)ptr;
+	intz begin = (arena->flags & ArenaFlags_Chained) ? SignedSizeof(ArenaBlock) : 0;
+	return p >= arena->memory + begin && p <= arena->memory + arena->offset;
+}
+
+static inline void
+ArenaPopBlock_(Arena* arena)
+{
+	Trace();
+	ArenaBlock* block = (ArenaBlock*)arena->memory;
+	SafeAssert(block->prev);
+	
+	arena->memory = (uint8*)block->prev;
+	arena->size = block->prev->size;
+	arena->offset = block->prev_offset;
+	
+	block->prev = arena->free_blocks;
+	arena->free_blocks = block;
+}
 
 static inline Arena
 ArenaFromMemory(void* memory, intz size)
@@ -103,11 +230,19 @@ ArenaPushDirtyAligned(Arena* arena, intz size, intz alignment)
 	
 	if (Unlikely(needed > arena->size))
 	{
-		if (!arena->commit_memory_proc || !arena->commit_memory_proc(arena, needed))
+		if (arena->flags & ArenaFlags_Chained)
+			return ArenaPushNewBlock_(arena, size, alignment);
+		if (!arena->commit_memory_proc || !ArenaCommit_(arena, needed))
 			return NULL;
 		Assert(needed <= arena->size);
 	}
 	
+#ifdef CONFIG_ARENA_STATS
+	arena->stats.push_count += 1;
+	arena->stats.padding_bytes += target_offset - arena->offset;
+	arena->stats.peak_offset = Max(arena->stats.peak_offset, needed);
+#endif
+	
 	void* result = arena->memory + target_offset;
 	arena->offset = needed;
 	
@@ -118,10 +253,18 @@ static inline void
 ArenaPop(Arena* arena, void* ptr)
 {
 	uint8* p = (uint8*)ptr;
+	if (Unlikely(arena->flags & ArenaFlags_Chained))
+	{
+		while (!ArenaBlockContains_(arena, p))
+			ArenaPopBlock_(arena);
+	}
 	SafeAssert(p >= arena->memory && p <= arena->memory + arena->offset);
 	
 	intz new_offset = p - arena->memory;
 	arena->offset = new_offset;
+	
+	if (Unlikely(arena->flags & ArenaFlags_Decommit))
+		ArenaTrim(arena);
 }
 
 static inline String
@@ -163,6 +306,7 @@ ArenaSave(Arena* arena)
 	ArenaSavepoint ret = {
 		arena,
 		arena->offset,
+		arena->memory,
 	};
 	
 	return ret;
@@ -183,7 +327,18 @@ ArenaPushCString(Arena* arena, String str)
 
 static inline void
 ArenaRestore(ArenaSavepoint savepoint)
-{ savepoint.arena->offset = savepoint.offset; }
+{
+	Arena* arena = savepoint.arena;
+	if (Unlikely(arena->flags & ArenaFlags_Chained))
+	{
+		while (arena->memory != savepoint.memory)
+			ArenaPopBlock_(arena);
+	}
+	arena->offset = savepoint.offset;
+	
+	if (Unlikely(arena->flags & ArenaFlags_Decommit))
+		ArenaTrim(arena);
+}
 
 static inline void*
 ArenaPushDirty(Arena* arena, intz size)
@@ -254,17 +409,101 @@ ArenaPushStringAligned(Arena* arena, String str, intz alignment)
 static inline void
 ArenaClear(Arena* arena)
 {
+	intz begin = 0;
+	if (Unlikely(arena->flags & ArenaFlags_Chained))
+	{
+		while (((ArenaBlock*)arena->memory)->prev)
+			ArenaPopBlock_(arena);
+		begin = SignedSizeof(ArenaBlock);
+	}
+	
 	// NOTE(ljre): If this arena is bootstrapped by itself, then don't free itself
-	if ((uint8*)arena == arena->memory)
-		arena->offset = SignedSizeof(Arena);
+	if ((uint8*)arena == arena->memory + begin)
+		arena->offset = begin + SignedSizeof(Arena);
 	else
-		arena->offset = 0;
+		arena->offset = begin;
+	
+	if (Unlikely(arena->flags & ArenaFlags_Decommit))
+		ArenaTrim(arena);
+}
+
+// NOTE(ljre): Enables decommitting for arenas whose commit_memory_proc() knows how to shrink (like the
+//             ones from ArenaReserve()). Memory above Max(offset, high_water) is only given back once
+//             there's more than hysteresis bytes of it, so loops that oscillate around a commit
+//             boundary don't keep committing and decommitting the same pages.
+static inline void
+ArenaSetDecommitPolicy(Arena* arena, intz high_water, intz hysteresis)
+{
+	SafeAssert(high_water >= 0 && hysteresis >= 0);
+	Assert(arena->commit_memory_proc);
+	
+	arena->flags |= ArenaFlags_Decommit;
+	arena->decommit_high_water = high_water;
+	arena->decommit_hysteresis = Max(hysteresis, arena->commit_granularity);
+}
+
+static inline void
+ArenaTrim(Arena* arena)
+{
+	Trace();
+	intz keep = Max(arena->offset, arena->decommit_high_water);
+	
+	if (arena->commit_memory_proc && arena->size - keep > arena->decommit_hysteresis)
+		ArenaCommit_(arena, keep);
+}
+
+static inline ArenaStats
+ArenaGetStats(Arena* arena)
+{
+#ifdef CONFIG_ARENA_STATS
+	return arena->stats;
+#else
+	(void)arena;
+	ArenaStats result = { 0 };
+	return result;
+#endif
+}
+
+static inline void
+ArenaAccumulateStats(ArenaStats* total, ArenaStats const* stats)
+{
+	total->peak_offset = Max(total->peak_offset, stats->peak_offset);
+	total->push_count += stats->push_count;
+	total->padding_bytes += stats->padding_bytes;
+	total->commit_count += stats->commit_count;
+	total->commit_nanoseconds += stats->commit_nanoseconds;
 }
 
 static inline void*
 ArenaEnd(Arena* arena)
 { return arena->memory + arena->offset; }
 
+// NOTE(ljre): Resizes the allocation in place if it's the last one of the current block.
+static inline bool
+ArenaResizeTip_(Arena* arena, void* old_ptr, intz old_size, intz size, bool zeroed)
+{
+	if (!ArenaBlockContains_(arena, old_ptr))
+		return false;
+	
+	intz old_offset = (uint8*)old_ptr - arena->memory;
+	if (old_offset + old_size != arena->offset)
+		return false;
+	
+	if (old_size < size)
+	{
+		// NOTE(ljre): Growing a chained arena past its current block would not be contiguous
+		if ((arena->flags & ArenaFlags_Chained) && old_offset + size > arena->size)
+			return false;
+		void* tail = zeroed ? ArenaPushAligned(arena, size - old_size, 1) : ArenaPushDirtyAligned(arena, size - old_size, 1);
+		if (!tail)
+			return false;
+	}
+	else if (old_size > size)
+		ArenaPop(arena, arena->memory + old_offset + size);
+	
+	return true;
+}
+
 static void*
 ArenaAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
 {
@@ -297,9 +536,8 @@ ArenaAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment
 		{
 			if (!old_ptr)
 				break; // free(NULL) has to be noop?
-			SafeAssert((uint8*)old_ptr >= arena->memory && (uint8*)old_ptr <= arena->memory + arena->offset);
-			intz old_offset = (uint8*)old_ptr - arena->memory;
-			if (old_offset + old_size == arena->offset)
+			SafeAssert((arena->flags & ArenaFlags_Chained) || ArenaBlockContains_(arena, old_ptr));
+			if (ArenaBlockContains_(arena, old_ptr) && (uint8*)old_ptr + old_size == arena->memory + arena->offset)
 				ArenaPop(arena, old_ptr);
 		} break;
 		case AllocatorMode_Resize:
@@ -316,17 +554,10 @@ ArenaAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment
 					error = AllocatorError_OutOfMemory;
 				break;
 			}
-			SafeAssert((uint8*)old_ptr >= arena->memory && (uint8*)old_ptr <= arena->memory + arena->offset);
+			SafeAssert((arena->flags & ArenaFlags_Chained) || ArenaBlockContains_(arena, old_ptr));
 
-			intz old_offset = (uint8*)old_ptr - arena->memory;
-			if (old_offset + old_size == arena->offset)
-			{
-				if (old_size < size)
-					ArenaPushAligned(arena, size - old_size, 1);
-				else if (old_size > size)
-					ArenaPop(arena, arena->memory + old_offset + size);
+			if (ArenaResizeTip_(arena, old_ptr, old_size, size, true))
 				result = old_ptr;
-			}
 			else
 			{
 				// welp, this is really sad
@@ -376,16 +607,10 @@ ArenaAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment
 					error = AllocatorError_OutOfMemory;
 				break;
 			}
-			SafeAssert((uint8*)old_ptr >= arena->memory && (uint8*)old_ptr <= arena->memory + arena->offset);
-			intz old_offset = (uint8*)old_ptr - arena->memory;
-			if (old_offset + old_size == arena->offset)
-			{
-				if (old_size < size)
-					ArenaPushDirtyAligned(arena, size - old_size, 1);
-				else if (old_size > size)
-					ArenaPop(arena, arena->memory + old_offset + size);
+			SafeAssert((arena->flags & ArenaFlags_Chained) || ArenaBlockContains_(arena, old_ptr));
+
+			if (ArenaResizeTip_(arena, old_ptr, old_size, size, false))
 				result = old_ptr;
-			}
 			else
 			{
 				// also sad
@@ -404,20 +629,87 @@ ArenaAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment
 			SafeAssert(old_ptr && ((uintptr)old_ptr & sizeof(uint32)-1) == 0);
 			uint32* features_ptr = (uint32*)old_ptr;
 			*features_ptr =
-				AllocatorMode_Alloc |
-				AllocatorMode_AllocNonZeroed |
-				AllocatorMode_Resize |
-				AllocatorMode_ResizeNonZeroed |
-				AllocatorMode_Free |
-				AllocatorMode_FreeAll |
-				AllocatorMode_Pop |
-				AllocatorMode_QueryFeatures;
+				AllocatorFeature_Alloc |
+				AllocatorFeature_AllocNonZeroed |
+				AllocatorFeature_Resize |
+				AllocatorFeature_ResizeNonZeroed |
+				AllocatorFeature_Free |
+				AllocatorFeature_FreeAll |
+				AllocatorFeature_Pop |
+				AllocatorFeature_AllocBatch |
+				AllocatorFeature_FreeBatch |
+				AllocatorFeature_QueryFeatures |
+				AllocatorFeature_QueryInfo |
+				AllocatorFeature_FreeIsOptional |
+				AllocatorFeature_ResizeInPlace;
+		} break;
+		case AllocatorMode_QueryInfo:
+		{
+			SafeAssert(old_ptr);
+			AllocatorInfo* info = (AllocatorInfo*)old_ptr;
+			info->used = arena->offset;
+			info->committed = arena->size;
+			info->reserved = Max(arena->reserved, arena->size);
+			info->thread_safe = false;
+
+			if (arena->flags & ArenaFlags_Chained)
+			{
+				info->used -= SignedSizeof(ArenaBlock);
+				for (ArenaBlock* block = (ArenaBlock*)arena->memory; block->prev; block = block->prev)
+				{
+					info->used += block->prev_offset - SignedSizeof(ArenaBlock);
+					info->committed += block->prev->size;
+				}
+				for (ArenaBlock* block = arena->free_blocks; block; block = block->prev)
+					info->committed += block->size;
+				info->reserved = info->committed;
+			}
 		} break;
 		case AllocatorMode_Pop:
 		{
-			SafeAssert((uint8*)old_ptr >= arena->memory && (uint8*)old_ptr <= arena->memory + arena->offset);
 			ArenaPop(arena, old_ptr);
 		} break;
+		case AllocatorMode_AllocBatch:
+		{
+			void** ptrs = (void**)old_ptr;
+			if (is_invalid_alignment || size < 0 || old_size < 0 || (!ptrs && old_size))
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+
+			intz stride = AlignUp(size, alignment-1);
+			uint8* memory = NULL;
+			if (!stride || old_size <= INTZ_MAX / stride)
+				memory = (uint8*)ArenaPushAligned(arena, stride * old_size, alignment);
+			if (!memory)
+			{
+				error = AllocatorError_OutOfMemory;
+				break;
+			}
+
+			for (intz i = 0; i < old_size; ++i)
+				ptrs[i] = memory + i * stride;
+			result = ptrs;
+		} break;
+		case AllocatorMode_FreeBatch:
+		{
+			// NOTE(ljre): Only the allocations at the end can be given back, so start from the last one
+			//             and stop at the first one that isn't. AllocBatch pads each allocation up to
+			//             'alignment', so an allocation is at the end if it or its padding ends at the tip.
+			void** ptrs = (void**)old_ptr;
+			intz stride = is_invalid_alignment ? size : AlignUp(size, alignment-1);
+			for (intz i = old_size-1; i >= 0; --i)
+			{
+				uint8* ptr = (uint8*)ptrs[i];
+				if (!ptr)
+					continue;
+				uint8* end = arena->memory + arena->offset;
+				if (!ArenaBlockContains_(arena, ptr) || (ptr + stride != end && ptr + size != end))
+					break;
+				ArenaPop(arena, ptr);
+			}
+		} break;
 		default:
 		{
 			error = AllocatorError_ModeNotImplemented;
@@ -440,6 +732,52 @@ AllocatorFromArena(Arena* arena)
 	};
 }
 
+// NOTE(ljre): Moves the arena to another budget (or to none, if NULL), charging it for what's already
+//             committed. Returns false, and leaves the arena as it was, if that goes over its hard limit.
+//             Only arenas that commit their own memory (virtual, chained or file backed) can have one.
+static inline bool
+ArenaSetBudget(Arena* arena, MemoryBudget* budget)
+{
+	Trace();
+	Assert(arena->commit_memory_proc || (arena->flags & ArenaFlags_Chained));
+	
+	AllocatorInfo info;
+	ArenaAllocatorProc(arena, AllocatorMode_QueryInfo, 0, 0, &info, 0, NULL);
+	
+	if (budget && !MemoryBudgetCharge(budget, info.committed))
+		return false;
+	if (arena->budget)
+		MemoryBudgetRelease(arena->budget, info.committed);
+	arena->budget = budget;
+	return true;
+}
+
+#ifdef __cplusplus
+// NOTE(ljre): Lets the allocator templates in base_allocator.h take an Arena* directly. Alloc doesn't go
+//             through ArenaAllocatorProc, so AllocatorNew<T>(arena, ...) inlines down to ArenaPushAligned().
+static inline FORCE_INLINE void*
+AllocatorCall_(Arena* arena, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	if ((mode == AllocatorMode_Alloc || mode == AllocatorMode_AllocNonZeroed) && size > 0 && alignment > 0 && IsPowerOf2(alignment))
+	{
+		void* result;
+		if (mode == AllocatorMode_Alloc)
+			result = ArenaPushAligned(arena, size, alignment);
+		else
+			result = ArenaPushDirtyAligned(arena, size, alignment);
+
+		AllocatorError error = result ? AllocatorError_Ok : AllocatorError_OutOfMemory;
+		if (out_err)
+			*out_err = error;
+		else
+			SafeAssert(error == AllocatorError_Ok);
+		return result;
+	}
+
+	return ArenaAllocatorProc(arena, mode, size, alignment, old_ptr, old_size, out_err);
+}
+#endif //__cplusplus
+
 // #ifdef __cplusplus
 // struct ScratchScope
 // {
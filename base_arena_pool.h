@@ -0,0 +1,130 @@
+#ifndef LJRE_BASE_ARENA_POOL_H
+#define LJRE_BASE_ARENA_POOL_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+#include "base_atomic.h"
+
+// NOTE(ljre): A fixed set of arenas reserved up front and handed out through a lock-free free list, so
+//             short-lived tasks don't pay for a reserve/release pair each. Arenas are cleared when they
+//             come back and keep at most max_retained_commit bytes committed.
+//
+//             The free list head packs a generation tag in the upper 32 bits and (index+1) in the lower
+//             32 bits, so a concurrent pop/push/pop of the same entry can't be mistaken for no change.
+struct ArenaPoolEntry
+{
+	Arena arena;
+	int32 next;
+}
+typedef ArenaPoolEntry;
+
+struct ArenaPool
+{
+	ArenaPoolEntry* entries;
+	int32 count;
+	intz max_retained_commit;
+	alignas(CONFIG_CACHELINE_SIZE) int64 free_head;
+}
+typedef ArenaPool;
+
+static inline bool   ArenaPoolInit   (ArenaPool* pool, Arena* storage, int32 count, intz reserve_size, intz commit_granularity, intz max_retained_commit);
+static inline void   ArenaPoolRelease(ArenaPool* pool);
+static inline Arena* ArenaPoolAcquire(ArenaPool* pool);
+static inline void   ArenaPoolReturn (ArenaPool* pool, Arena* arena);
+
+static inline void
+ArenaPoolPush_(ArenaPool* pool, int32 index)
+{
+	int64 head = AtomicLoad64Relaxed(&pool->free_head);
+	int64 new_head;
+	
+	do
+	{
+		AtomicStore32Relaxed(&pool->entries[index].next, (int32)(head & 0xffffffff) - 1);
+		new_head = (int64)(((uint64)head & ~(uint64)0xffffffff) + ((uint64)1 << 32)) | (uint32)(index + 1);
+	}
+	while (!AtomicCompareExchange64Rel(&pool->free_head, &head, new_head));
+}
+
+static inline bool
+ArenaPoolInit(ArenaPool* pool, Arena* storage, int32 count, intz reserve_size, intz commit_granularity, intz max_retained_commit)
+{
+	Trace();
+	SafeAssert(count >= 0 && max_retained_commit >= 0);
+	
+	ArenaPoolEntry* entries = ArenaPushArray(storage, ArenaPoolEntry, count);
+	if (!entries)
+		return false;
+	
+	for (int32 i = 0; i < count; ++i)
+	{
+		entries[i].arena = ArenaReserve(reserve_size, commit_granularity);
+		if (!entries[i].arena.memory)
+		{
+			for (int32 j = 0; j < i; ++j)
+				ArenaRelease(&entries[j].arena);
+			return false;
+		}
+	}
+	
+	pool->entries = entries;
+	pool->count = count;
+	pool->max_retained_commit = max_retained_commit;
+	pool->free_head = 0;
+	
+	for (int32 i = count - 1; i >= 0; --i)
+		ArenaPoolPush_(pool, i);
+	
+	return true;
+}
+
+// NOTE(ljre): Not thread-safe; every arena should have been returned already.
+static inline void
+ArenaPoolRelease(ArenaPool* pool)
+{
+	Trace();
+	for (int32 i = 0; i < pool->count; ++i)
+		ArenaRelease(&pool->entries[i].arena);
+	
+	pool->entries = NULL;
+	pool->count = 0;
+	pool->free_head = 0;
+}
+
+// NOTE(ljre): Returns NULL if every arena is in use.
+static inline Arena*
+ArenaPoolAcquire(ArenaPool* pool)
+{
+	Trace();
+	int64 head = AtomicLoad64Acq(&pool->free_head);
+	
+	for (;;)
+	{
+		int32 index = (int32)(head & 0xffffffff) - 1;
+		if (index < 0)
+			return NULL;
+		
+		int32 next = AtomicLoad32Relaxed(&pool->entries[index].next);
+		int64 new_head = (int64)(((uint64)head & ~(uint64)0xffffffff) + ((uint64)1 << 32)) | (uint32)(next + 1);
+		
+		if (AtomicCompareExchange64AcqRel(&pool->free_head, &head, new_head))
+			return &pool->entries[index].arena;
+	}
+}
+
+static inline void
+ArenaPoolReturn(ArenaPool* pool, Arena* arena)
+{
+	Trace();
+	intz index = (ArenaPoolEntry*)arena - pool->entries;
+	SafeAssert(index >= 0 && index < pool->count && &pool->entries[index].arena == arena);
+	
+	ArenaClear(arena);
+	if (arena->size > pool->max_retained_commit)
+		ArenaCommit_(arena, pool->max_retained_commit);
+	
+	ArenaPoolPush_(pool, (int32)index);
+}
+
+#endif //LJRE_BASE_ARENA_POOL_H
@@ -0,0 +1,157 @@
+#ifndef LJRE_BASE_ARRAY_H
+#define LJRE_BASE_ARRAY_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+#include "base_allocator.h"
+
+// NOTE(ljre): Growable arrays on top of an Allocator. When the allocator is an arena and the array is the
+//             last thing pushed into it, growing just extends the array in place by exactly what's needed
+//             (like ArenaBeginArray()/ArenaEndArray() would). Otherwise, the capacity grows geometrically
+//             and AllocatorResizeNonZeroed() moves the elements.
+//
+//             In C, declare them with ArrayOf(Type):
+//                 ArrayOf(int32) numbers = { .allocator = AllocatorFromArena(arena) };
+//                 ArrayPush(&numbers, 42);
+#define ArrayOf(Type) struct { Type* data; intz count; intz capacity; Allocator allocator; }
+
+// NOTE(ljre): Element alignment is taken as the lowest set bit of the element size. That is always a
+//             multiple of the real alignment, since sizeof is.
+#define ArrayElementAlignment_(arr) (SignedSizeof(*(arr)->data) & -SignedSizeof(*(arr)->data))
+
+#define ArrayReserve(arr, new_capacity, out_err) \
+	ArrayGrow_((arr)->allocator, (void**)&(arr)->data, &(arr)->capacity, new_capacity, SignedSizeof(*(arr)->data), ArrayElementAlignment_(arr), out_err)
+#define ArrayPush(arr, ...) \
+	((void)ArrayReserve(arr, (arr)->count + 1, NULL), (arr)->data[(arr)->count++] = (__VA_ARGS__))
+#define ArrayPushArray(arr, items, item_count) \
+	((void)ArrayReserve(arr, (arr)->count + (item_count), NULL), \
+	MemoryCopy((arr)->data + (arr)->count, items, SignedSizeof(*(arr)->data) * (item_count)), \
+	(arr)->count += (item_count))
+#define ArrayPop(arr) \
+	((arr)->data[ArrayPopIndex_(&(arr)->count)])
+#define ArrayShrinkToFit(arr, out_err) \
+	ArrayShrink_((arr)->allocator, (void**)&(arr)->data, &(arr)->capacity, (arr)->count, SignedSizeof(*(arr)->data), ArrayElementAlignment_(arr), out_err)
+#define ArrayFree(arr, out_err) \
+	(AllocatorFree((arr)->allocator, (arr)->data, (arr)->capacity * SignedSizeof(*(arr)->data), out_err), \
+	(arr)->data = NULL, (arr)->count = 0, (arr)->capacity = 0)
+
+static inline intz
+ArrayPopIndex_(intz* count)
+{
+	SafeAssert(*count > 0);
+	return --*count;
+}
+
+static inline bool
+ArrayIsAtArenaTip_(Allocator allocator, void* data, intz size)
+{
+	if (allocator.proc != ArenaAllocatorProc || !data)
+		return false;
+
+	Arena* arena = (Arena*)allocator.instance;
+	return ArenaBlockContains_(arena, data) && (uint8*)data + size == (uint8*)ArenaEnd(arena);
+}
+
+static inline bool
+ArrayGrow_(Allocator allocator, void** data, intz* capacity, intz needed, intz elem_size, intz alignment, AllocatorError* out_err)
+{
+	if (Likely(needed <= *capacity))
+		return true;
+
+	Trace();
+	SafeAssert(needed <= INTZ_MAX / elem_size);
+
+	intz new_capacity = needed;
+	if (!ArrayIsAtArenaTip_(allocator, *data, *capacity * elem_size))
+	{
+		new_capacity = Max(new_capacity, 4);
+		if (*capacity <= INTZ_MAX / elem_size / 2)
+			new_capacity = Max(new_capacity, *capacity * 2);
+	}
+
+	void* new_data = AllocatorResizeNonZeroed(allocator, new_capacity * elem_size, alignment, *data, *capacity * elem_size, out_err);
+	if (!new_data)
+		return false;
+
+	*data = new_data;
+	*capacity = new_capacity;
+	return true;
+}
+
+static inline bool
+ArrayShrink_(Allocator allocator, void** data, intz* capacity, intz count, intz elem_size, intz alignment, AllocatorError* out_err)
+{
+	Trace();
+	if (count >= *capacity || !*data)
+		return true;
+
+	void* new_data = AllocatorResizeNonZeroed(allocator, count * elem_size, alignment, *data, *capacity * elem_size, out_err);
+	if (!new_data && count > 0)
+		return false;
+
+	*data = new_data;
+	*capacity = count;
+	return true;
+}
+
+#ifdef __cplusplus
+template <typename T>
+struct Array : Slice<T>
+{
+	intz capacity;
+	Allocator allocator;
+
+	inline bool Reserve(intz new_capacity, AllocatorError* out_err = NULL)
+	{ return ArrayGrow_(allocator, (void**)&this->data, &capacity, new_capacity, SignedSizeof(T), alignof(T), out_err); }
+	inline bool ShrinkToFit(AllocatorError* out_err = NULL)
+	{ return ArrayShrink_(allocator, (void**)&this->data, &capacity, this->count, SignedSizeof(T), alignof(T), out_err); }
+
+	inline T* Push(T const& item, AllocatorError* out_err = NULL)
+	{
+		if (!Reserve(this->count + 1, out_err))
+			return NULL;
+		T* result = &this->data[this->count++];
+		*result = item;
+		return result;
+	}
+
+	inline Slice<T> PushSlice(Slice<T const> items, AllocatorError* out_err = NULL)
+	{
+		if (!Reserve(this->count + items.count, out_err))
+			return {};
+		Slice<T> result = { this->data + this->count, items.count };
+		MemoryCopy(result.data, items.data, items.count * SignedSizeof(T));
+		this->count += items.count;
+		return result;
+	}
+
+	inline T Pop()
+	{
+		SafeAssert(this->count > 0);
+		return this->data[--this->count];
+	}
+
+	inline void Clear() { this->count = 0; }
+	inline Slice<T> Items() const { return { this->data, this->count }; }
+
+	inline void Free(AllocatorError* out_err = NULL)
+	{
+		AllocatorFree(allocator, this->data, capacity * SignedSizeof(T), out_err);
+		this->data = NULL;
+		this->count = 0;
+		capacity = 0;
+	}
+};
+
+template <typename T>
+static inline Array<T>
+ArrayFromAllocator(Allocator allocator)
+{
+	Array<T> result = {};
+	result.allocator = allocator;
+	return result;
+}
+#endif //__cplusplus
+
+#endif //LJRE_BASE_ARRAY_H
@@ -115,6 +115,16 @@ _DEFINE_ATOMIC_PROCS(Dec, X_DEC);
 #undef X_INC
 #undef X_DEC
 
+static inline FORCE_INLINE void
+AtomicPause(void)
+{
+#if defined(CONFIG_ARCH_X86FAMILY)
+	__builtin_ia32_pause();
+#elif defined(CONFIG_ARCH_ARMFAMILY)
+	__asm__ __volatile__ ("yield");
+#endif
+}
+
 #elif defined(_MSC_VER)
 
 // TODO(ljre)
@@ -0,0 +1,141 @@
+#ifndef LJRE_BASE_BUDGET_H
+#define LJRE_BASE_BUDGET_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_atomic.h"
+
+// NOTE(ljre): Memory budget shared by any number of arenas (and the heaps built on top of them, like
+//             TlsfHeap and ThreadCachingHeap). Arenas with a budget charge it for every byte they commit
+//             and give it back when they decommit or are released (see ArenaSetBudget()).
+//
+//             Going over hard_limit makes the commit fail, so the push returns NULL and allocators report
+//             AllocatorError_OutOfMemory. Going over soft_limit, or failing on the hard limit, only marks
+//             the budget: charges happen inside commit procs, often under a heap's or arena's lock, so
+//             soft_limit_proc() is called later by MemoryBudgetPoll(). Call it at safe points (once per
+//             frame or request, or after an allocation fails); it should make room by trimming arenas or
+//             evicting caches.
+//
+//             Only one thread runs soft_limit_proc() at a time, and polls from other threads in the
+//             meantime don't wait for it. It may trim, clear or release arenas charging this budget, but
+//             must not allocate from or free into an allocator charging it while that allocator might be
+//             in use by another thread. Limits of 0 mean no limit. Slabs taken straight from the OS (a
+//             SlabAllocator without an arena) aren't charged.
+typedef void MemoryBudgetSoftLimitProc(MemoryBudget* budget, intz used);
+
+struct MemoryBudget
+{
+	intz soft_limit;
+	intz hard_limit;
+	MemoryBudgetSoftLimitProc* soft_limit_proc;
+	void* user_data;
+
+	alignas(CONFIG_CACHELINE_SIZE) int64 used;
+	int64 peak;
+	int64 failed_charges;
+	int32 soft_limit_pending;
+	int32 in_soft_limit_proc;
+};
+
+static inline void MemoryBudgetInit   (MemoryBudget* budget, intz soft_limit, intz hard_limit, MemoryBudgetSoftLimitProc* soft_limit_proc, void* user_data);
+static inline bool MemoryBudgetCharge (MemoryBudget* budget, intz size);
+static inline void MemoryBudgetRelease(MemoryBudget* budget, intz size);
+static inline intz MemoryBudgetUsed   (MemoryBudget* budget);
+static inline bool MemoryBudgetPoll   (MemoryBudget* budget);
+
+static inline void
+MemoryBudgetInit(MemoryBudget* budget, intz soft_limit, intz hard_limit, MemoryBudgetSoftLimitProc* soft_limit_proc, void* user_data)
+{
+	SafeAssert(soft_limit >= 0 && hard_limit >= 0);
+	MemoryZero(budget, SignedSizeof(*budget));
+
+	budget->soft_limit = soft_limit;
+	budget->hard_limit = hard_limit;
+	budget->soft_limit_proc = soft_limit_proc;
+	budget->user_data = user_data;
+}
+
+static inline bool
+MemoryBudgetTryCharge_(MemoryBudget* budget, intz size, int64* out_used)
+{
+	int64 used = AtomicLoad64Relaxed(&budget->used);
+	int64 new_used;
+
+	do
+	{
+		new_used = used + size;
+		if (budget->hard_limit && new_used > budget->hard_limit)
+			return false;
+	}
+	while (!AtomicCompareExchange64Relaxed(&budget->used, &used, new_used));
+
+	*out_used = new_used;
+	return true;
+}
+
+static inline void
+MemoryBudgetSetPending_(MemoryBudget* budget)
+{
+	if (budget->soft_limit_proc && !AtomicLoad32Relaxed(&budget->soft_limit_pending))
+		AtomicStore32Relaxed(&budget->soft_limit_pending, 1);
+}
+
+static inline bool
+MemoryBudgetCharge(MemoryBudget* budget, intz size)
+{
+	SafeAssert(size >= 0);
+	int64 new_used;
+
+	if (Unlikely(!MemoryBudgetTryCharge_(budget, size, &new_used)))
+	{
+		AtomicInc64Relaxed(&budget->failed_charges);
+		MemoryBudgetSetPending_(budget);
+		return false;
+	}
+
+	int64 peak = AtomicLoad64Relaxed(&budget->peak);
+	while (new_used > peak && !AtomicCompareExchange64Relaxed(&budget->peak, &peak, new_used))
+		;
+
+	if (budget->soft_limit && new_used > budget->soft_limit)
+		MemoryBudgetSetPending_(budget);
+
+	return true;
+}
+
+static inline void
+MemoryBudgetRelease(MemoryBudget* budget, intz size)
+{
+	SafeAssert(size >= 0);
+	int64 used = AtomicSubFetch64Relaxed(&budget->used, size);
+	SafeAssert(used >= 0);
+}
+
+static inline intz
+MemoryBudgetUsed(MemoryBudget* budget)
+{ return (intz)AtomicLoad64Relaxed(&budget->used); }
+
+// NOTE(ljre): Calls soft_limit_proc() if a charge went over the soft limit or failed on the hard limit
+//             since the last poll. Returns true if it was called.
+static inline bool
+MemoryBudgetPoll(MemoryBudget* budget)
+{
+	if (Likely(!AtomicLoad32Relaxed(&budget->soft_limit_pending)))
+		return false;
+
+	Trace();
+	if (AtomicExchange32Acq(&budget->in_soft_limit_proc, 1))
+		return false;
+
+	bool ran = false;
+	if (AtomicExchange32Relaxed(&budget->soft_limit_pending, 0))
+	{
+		budget->soft_limit_proc(budget, (intz)AtomicLoad64Relaxed(&budget->used));
+		ran = true;
+	}
+
+	AtomicStore32Rel(&budget->in_soft_limit_proc, 0);
+	return ran;
+}
+
+#endif //LJRE_BASE_BUDGET_H
@@ -0,0 +1,260 @@
+#ifndef LJRE_BASE_CONCURRENT_ARENA_H
+#define LJRE_BASE_CONCURRENT_ARENA_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+#include "base_atomic.h"
+
+// NOTE(ljre): Bump arena that many threads can push into at the same time. The offset is advanced with a
+//             single atomic add, and only one thread at a time calls the commit_memory_proc() of the
+//             underlying arena while the others keep allocating below the committed mark.
+//
+//             Every push is rounded up to CONFIG_ARENA_DEFAULT_ALIGNMENT so that pushes with smaller
+//             alignments never need padding. ConcurrentArenaClear() is not thread-safe.
+struct ConcurrentArena
+{
+	Arena base; // base.size is only touched while holding commit_lock
+	alignas(CONFIG_CACHELINE_SIZE) int64 offset;
+	alignas(CONFIG_CACHELINE_SIZE) int64 committed;
+	int32 commit_lock;
+}
+typedef ConcurrentArena;
+
+static inline ConcurrentArena ConcurrentArenaFromArena       (Arena arena);
+static inline void*           ConcurrentArenaPush            (ConcurrentArena* arena, intz size);
+static inline void*           ConcurrentArenaPushDirty       (ConcurrentArena* arena, intz size);
+static inline void*           ConcurrentArenaPushAligned     (ConcurrentArena* arena, intz size, intz alignment);
+static inline void*           ConcurrentArenaPushDirtyAligned(ConcurrentArena* arena, intz size, intz alignment);
+static inline void*           ConcurrentArenaEnd             (ConcurrentArena* arena);
+static inline void            ConcurrentArenaClear           (ConcurrentArena* arena);
+
+static inline Allocator AllocatorFromConcurrentArena(ConcurrentArena* arena);
+
+static inline ConcurrentArena
+ConcurrentArenaFromArena(Arena arena)
+{
+	Assert(((uintptr)arena.memory & (CONFIG_ARENA_DEFAULT_ALIGNMENT-1)) == 0);
+	Assert(!(arena.flags & ArenaFlags_Chained));
+	
+	ConcurrentArena result = {
+		.base = arena,
+		.offset = AlignUp(arena.offset, CONFIG_ARENA_DEFAULT_ALIGNMENT-1),
+		.committed = arena.size,
+	};
+	
+	return result;
+}
+
+static bool
+ConcurrentArenaCommit_(ConcurrentArena* arena, int64 needed)
+{
+	Trace();
+	
+	for (;;)
+	{
+		if (needed <= AtomicLoad64Acq(&arena->committed))
+			return true;
+		
+		int32 expected = 0;
+		if (!AtomicCompareExchange32Acq(&arena->commit_lock, &expected, 1))
+		{
+			AtomicPause();
+			continue;
+		}
+		
+		bool ok = true;
+		if (needed > arena->base.size)
+			ok = arena->base.commit_memory_proc && ArenaCommit_(&arena->base, (intz)needed);
+		if (ok)
+			AtomicStore64Rel(&arena->committed, arena->base.size);
+		AtomicStore32Rel(&arena->commit_lock, 0);
+		
+		if (!ok)
+			return false;
+	}
+}
+
+static inline void*
+ConcurrentArenaPushDirtyAligned(ConcurrentArena* arena, intz size, intz alignment)
+{
+	Trace();
+	Assert(alignment != 0 && IsPowerOf2(alignment));
+	SafeAssert(size >= 0);
+	
+	int64 amount = AlignUp(size, CONFIG_ARENA_DEFAULT_ALIGNMENT-1);
+	if (alignment > CONFIG_ARENA_DEFAULT_ALIGNMENT)
+		amount += alignment - CONFIG_ARENA_DEFAULT_ALIGNMENT;
+	
+	int64 end = AtomicAddFetch64Relaxed(&arena->offset, amount);
+	int64 begin = end - amount;
+	
+	if (Unlikely(end > AtomicLoad64Acq(&arena->committed)) && !ConcurrentArenaCommit_(arena, end))
+		return NULL;
+	
+	return (void*)AlignUp((uintptr)(arena->base.memory + begin), (uintptr)alignment-1);
+}
+
+static inline void*
+ConcurrentArenaPushAligned(ConcurrentArena* arena, intz size, intz alignment)
+{
+	Trace();
+	void* data = ConcurrentArenaPushDirtyAligned(arena, size, alignment);
+	if (data)
+		MemoryZero(data, size);
+	return data;
+}
+
+static inline void*
+ConcurrentArenaPushDirty(ConcurrentArena* arena, intz size)
+{ return ConcurrentArenaPushDirtyAligned(arena, size, CONFIG_ARENA_DEFAULT_ALIGNMENT); }
+
+static inline void*
+ConcurrentArenaPush(ConcurrentArena* arena, intz size)
+{ return ConcurrentArenaPushAligned(arena, size, CONFIG_ARENA_DEFAULT_ALIGNMENT); }
+
+static inline void*
+ConcurrentArenaEnd(ConcurrentArena* arena)
+{ return arena->base.memory + AtomicLoad64Relaxed(&arena->offset); }
+
+static inline void
+ConcurrentArenaClear(ConcurrentArena* arena)
+{
+	ArenaClear(&arena->base);
+	AtomicStore64Relaxed(&arena->offset, AlignUp(arena->base.offset, CONFIG_ARENA_DEFAULT_ALIGNMENT-1));
+	AtomicStore64Rel(&arena->committed, arena->base.size);
+}
+
+static void*
+ConcurrentArenaAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	Trace();
+	void* result = NULL;
+	AllocatorError error = AllocatorError_Ok;
+	ConcurrentArena* arena = (ConcurrentArena*)instance;
+	
+	bool is_invalid_alignment = (!alignment || (alignment & alignment-1) != 0);
+	
+	switch (mode)
+	{
+		case AllocatorMode_Alloc:
+		case AllocatorMode_AllocNonZeroed:
+		{
+			if (is_invalid_alignment)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			if (mode == AllocatorMode_Alloc)
+				result = ConcurrentArenaPushAligned(arena, size, alignment);
+			else
+				result = ConcurrentArenaPushDirtyAligned(arena, size, alignment);
+			if (!result)
+				error = AllocatorError_OutOfMemory;
+		} break;
+		case AllocatorMode_Free: break;
+		case AllocatorMode_Resize:
+		case AllocatorMode_ResizeNonZeroed:
+		{
+			if (is_invalid_alignment)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			if (old_ptr && size <= old_size)
+			{
+				result = old_ptr;
+				break;
+			}
+			
+			// NOTE(ljre): Other threads might have pushed after old_ptr, so we can't grow in place.
+			result = ConcurrentArenaPushDirtyAligned(arena, size, alignment);
+			if (!result)
+			{
+				error = AllocatorError_OutOfMemory;
+				break;
+			}
+			intz amount_to_copy = old_ptr ? old_size : 0;
+			MemoryCopy(result, old_ptr, amount_to_copy);
+			if (mode == AllocatorMode_Resize)
+				MemoryZero((uint8*)result + amount_to_copy, size - amount_to_copy);
+		} break;
+		case AllocatorMode_FreeAll:
+		{
+			ConcurrentArenaClear(arena);
+		} break;
+		case AllocatorMode_QueryFeatures:
+		{
+			SafeAssert(old_ptr && ((uintptr)old_ptr & sizeof(uint32)-1) == 0);
+			uint32* features_ptr = (uint32*)old_ptr;
+			*features_ptr =
+				AllocatorFeature_Alloc |
+				AllocatorFeature_AllocNonZeroed |
+				AllocatorFeature_Resize |
+				AllocatorFeature_ResizeNonZeroed |
+				AllocatorFeature_Free |
+				AllocatorFeature_FreeAll |
+				AllocatorFeature_AllocBatch |
+				AllocatorFeature_FreeBatch |
+				AllocatorFeature_QueryFeatures |
+				AllocatorFeature_QueryInfo |
+				AllocatorFeature_FreeIsOptional |
+				AllocatorFeature_ThreadSafe;
+		} break;
+		case AllocatorMode_QueryInfo:
+		{
+			SafeAssert(old_ptr);
+			AllocatorInfo* info = (AllocatorInfo*)old_ptr;
+			info->used = (intz)AtomicLoad64Relaxed(&arena->offset);
+			info->committed = (intz)AtomicLoad64Relaxed(&arena->committed);
+			info->reserved = Max(arena->base.reserved, info->committed);
+			info->thread_safe = true;
+		} break;
+		case AllocatorMode_AllocBatch:
+		{
+			void** ptrs = (void**)old_ptr;
+			if (is_invalid_alignment || size < 0 || old_size < 0 || (!ptrs && old_size))
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+
+			// NOTE(ljre): One atomic add for the whole batch.
+			intz stride = AlignUp(size, alignment-1);
+			uint8* memory = NULL;
+			if (!stride || old_size <= INTZ_MAX / stride)
+				memory = (uint8*)ConcurrentArenaPushAligned(arena, stride * old_size, alignment);
+			if (!memory)
+			{
+				error = AllocatorError_OutOfMemory;
+				break;
+			}
+
+			for (intz i = 0; i < old_size; ++i)
+				ptrs[i] = memory + i * stride;
+			result = ptrs;
+		} break;
+		case AllocatorMode_FreeBatch: break;
+		default:
+		{
+			error = AllocatorError_ModeNotImplemented;
+		} break;
+	}
+	
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+	return result;
+}
+
+static inline Allocator
+AllocatorFromConcurrentArena(ConcurrentArena* arena)
+{
+	return (Allocator) {
+		.proc = ConcurrentArenaAllocatorProc,
+		.instance = arena,
+	};
+}
+
+#endif //LJRE_BASE_CONCURRENT_ARENA_H
@@ -0,0 +1,359 @@
+#ifndef LJRE_BASE_DOUBLE_ARENA_H
+#define LJRE_BASE_DOUBLE_ARENA_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+
+// NOTE(ljre): Stack arena over a single block of memory that grows from both ends. The front grows up from
+//             the start, the back grows down from the end, and the arena is full when they meet. The usual
+//             split is results on the front and temporary work on the back, which gets thrown away with
+//             DoubleArenaRestore() (or DoubleArenaBackScope()) once it's done.
+//
+//             Each end has its own savepoints and its own Allocator (see AllocatorFromDoubleArenaFront() and
+//             AllocatorFromDoubleArenaBack()). Only the last allocation of each end can be freed or resized
+//             in place. The back has no AllocatorMode_Pop, since it'd need to know the size of the
+//             allocation to give it back.
+#define DoubleArenaPushFrontStruct(da, Type) \
+	((Type*)DoubleArenaPushFront(da, SignedSizeof(Type), alignof(Type)))
+#define DoubleArenaPushFrontArray(da, Type, count) \
+	((Type*)DoubleArenaPushFront(da, SignedSizeof(Type)*(count), alignof(Type)))
+#define DoubleArenaPushBackStruct(da, Type) \
+	((Type*)DoubleArenaPushBack(da, SignedSizeof(Type), alignof(Type)))
+#define DoubleArenaPushBackArray(da, Type, count) \
+	((Type*)DoubleArenaPushBack(da, SignedSizeof(Type)*(count), alignof(Type)))
+#define DoubleArenaBackScope(da_) \
+	(DoubleArenaSavepoint _temp__ = DoubleArenaSaveBack(da_); _temp__.arena; DoubleArenaRestore(_temp__), _temp__.arena = NULL)
+
+struct DoubleArena
+{
+	uint8* memory;
+	intz size;
+	intz front; // offset of the end of the front
+	intz back;  // offset of the start of the back
+}
+typedef DoubleArena;
+
+struct DoubleArenaSavepoint
+{
+	DoubleArena* arena;
+	intz offset;
+	bool is_back;
+}
+typedef DoubleArenaSavepoint;
+
+static inline DoubleArena DoubleArenaFromMemory    (void* memory, intz size);
+static inline DoubleArena DoubleArenaFromArena     (Arena* arena, intz size);
+static inline void*       DoubleArenaPushFront     (DoubleArena* da, intz size, intz alignment);
+static inline void*       DoubleArenaPushFrontDirty(DoubleArena* da, intz size, intz alignment);
+static inline void*       DoubleArenaPushBack      (DoubleArena* da, intz size, intz alignment);
+static inline void*       DoubleArenaPushBackDirty (DoubleArena* da, intz size, intz alignment);
+static inline intz        DoubleArenaFreeSpace     (DoubleArena* da);
+static inline void        DoubleArenaClearFront    (DoubleArena* da);
+static inline void        DoubleArenaClearBack     (DoubleArena* da);
+static inline DoubleArenaSavepoint DoubleArenaSaveFront(DoubleArena* da);
+static inline DoubleArenaSavepoint DoubleArenaSaveBack (DoubleArena* da);
+static inline void                 DoubleArenaRestore  (DoubleArenaSavepoint savepoint);
+
+static inline Allocator AllocatorFromDoubleArenaFront(DoubleArena* da);
+static inline Allocator AllocatorFromDoubleArenaBack (DoubleArena* da);
+
+static inline DoubleArena
+DoubleArenaFromMemory(void* memory, intz size)
+{
+	SafeAssert(size >= 0);
+
+	DoubleArena result = {
+		.memory = (uint8*)memory,
+		.size = size,
+		.front = 0,
+		.back = size,
+	};
+
+	return result;
+}
+
+// NOTE(ljre): Takes a block of 'size' bytes from 'arena'. If it fails, the resulting DoubleArena is empty.
+static inline DoubleArena
+DoubleArenaFromArena(Arena* arena, intz size)
+{
+	Trace();
+	void* memory = ArenaPushDirtyAligned(arena, size, CONFIG_ARENA_DEFAULT_ALIGNMENT);
+	return DoubleArenaFromMemory(memory, memory ? size : 0);
+}
+
+static inline void*
+DoubleArenaPushFrontDirty(DoubleArena* da, intz size, intz alignment)
+{
+	Assert(alignment != 0 && IsPowerOf2(alignment));
+	SafeAssert(size >= 0);
+
+	intptr target_offset = AlignUp((intptr)da->memory + da->front, alignment-1) - (intptr)da->memory;
+	if (Unlikely(target_offset > da->back || da->back - target_offset < size))
+		return NULL;
+
+	da->front = target_offset + size;
+	return da->memory + target_offset;
+}
+
+static inline void*
+DoubleArenaPushBackDirty(DoubleArena* da, intz size, intz alignment)
+{
+	Assert(alignment != 0 && IsPowerOf2(alignment));
+	SafeAssert(size >= 0);
+
+	if (Unlikely(da->back - da->front < size))
+		return NULL;
+	intptr target_offset = AlignDown((intptr)da->memory + da->back - size, alignment-1) - (intptr)da->memory;
+	if (Unlikely(target_offset < da->front))
+		return NULL;
+
+	da->back = target_offset;
+	return da->memory + target_offset;
+}
+
+static inline void*
+DoubleArenaPushFront(DoubleArena* da, intz size, intz alignment)
+{
+	void* data = DoubleArenaPushFrontDirty(da, size, alignment);
+	if (data)
+		MemoryZero(data, size);
+	return data;
+}
+
+static inline void*
+DoubleArenaPushBack(DoubleArena* da, intz size, intz alignment)
+{
+	void* data = DoubleArenaPushBackDirty(da, size, alignment);
+	if (data)
+		MemoryZero(data, size);
+	return data;
+}
+
+static inline intz
+DoubleArenaFreeSpace(DoubleArena* da)
+{ return da->back - da->front; }
+
+static inline void
+DoubleArenaClearFront(DoubleArena* da)
+{ da->front = 0; }
+
+static inline void
+DoubleArenaClearBack(DoubleArena* da)
+{ da->back = da->size; }
+
+static inline DoubleArenaSavepoint
+DoubleArenaSaveFront(DoubleArena* da)
+{
+	DoubleArenaSavepoint result = { da, da->front, false };
+	return result;
+}
+
+static inline DoubleArenaSavepoint
+DoubleArenaSaveBack(DoubleArena* da)
+{
+	DoubleArenaSavepoint result = { da, da->back, true };
+	return result;
+}
+
+static inline void
+DoubleArenaRestore(DoubleArenaSavepoint savepoint)
+{
+	DoubleArena* da = savepoint.arena;
+	if (savepoint.is_back)
+	{
+		SafeAssert(savepoint.offset >= da->back && savepoint.offset <= da->size);
+		da->back = savepoint.offset;
+	}
+	else
+	{
+		SafeAssert(savepoint.offset >= 0 && savepoint.offset <= da->front);
+		da->front = savepoint.offset;
+	}
+}
+
+// NOTE(ljre): Resizes the allocation in place if it's the last one of its end. Growing the last allocation
+//             of the back moves it down, so 'old_ptr' is only kept when it fits without moving.
+static inline void*
+DoubleArenaResize_(DoubleArena* da, bool is_back, void* old_ptr, intz old_size, intz size, intz alignment, bool zeroed)
+{
+	Trace();
+	uint8* old = (uint8*)old_ptr;
+	uint8* result = NULL;
+
+	if (!is_back && old && old + old_size == da->memory + da->front)
+	{
+		// NOTE(ljre): Nothing fits past the tip if the tip itself can't grow, so don't try to push.
+		intz old_offset = old - da->memory;
+		if (size > da->back - old_offset)
+			return NULL;
+		da->front = old_offset + size;
+		result = old;
+	}
+	else if (is_back && old && old == da->memory + da->back && size <= old_size)
+		result = old;
+	else if (is_back && old && old == da->memory + da->back)
+	{
+		// NOTE(ljre): Give the old allocation back and push the new one below it, then move the data down.
+		intz old_back = da->back;
+		da->back += old_size;
+		result = (uint8*)DoubleArenaPushBackDirty(da, size, alignment);
+		if (!result)
+		{
+			da->back = old_back;
+			return NULL;
+		}
+		MemoryMove(result, old, old_size);
+	}
+	else
+	{
+		result = is_back ? (uint8*)DoubleArenaPushBackDirty(da, size, alignment) : (uint8*)DoubleArenaPushFrontDirty(da, size, alignment);
+		if (!result)
+			return NULL;
+		if (old)
+			MemoryCopy(result, old, Min(size, old_size));
+	}
+
+	intz kept_size = old ? old_size : 0;
+	if (zeroed && size > kept_size)
+		MemoryZero(result + kept_size, size - kept_size);
+
+	return result;
+}
+
+static void*
+DoubleArenaAllocatorProc_(DoubleArena* da, bool is_back, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	Trace();
+	void* result = NULL;
+	AllocatorError error = AllocatorError_Ok;
+
+	bool is_invalid_alignment = (!alignment || (alignment & alignment-1) != 0);
+
+	switch (mode)
+	{
+		case AllocatorMode_Alloc:
+		case AllocatorMode_AllocNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			if (is_back)
+				result = DoubleArenaPushBackDirty(da, size, alignment);
+			else
+				result = DoubleArenaPushFrontDirty(da, size, alignment);
+			if (!result)
+				error = AllocatorError_OutOfMemory;
+			else if (mode == AllocatorMode_Alloc)
+				MemoryZero(result, size);
+		} break;
+		case AllocatorMode_Free:
+		{
+			uint8* ptr = (uint8*)old_ptr;
+			if (!ptr)
+				break;
+			SafeAssert(ptr >= da->memory && ptr + old_size <= da->memory + da->size);
+			if (!is_back && ptr + old_size == da->memory + da->front)
+				da->front = ptr - da->memory;
+			else if (is_back && ptr == da->memory + da->back)
+				da->back += old_size;
+		} break;
+		case AllocatorMode_Resize:
+		case AllocatorMode_ResizeNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0 || old_size < 0)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			result = DoubleArenaResize_(da, is_back, old_ptr, old_size, size, alignment, mode == AllocatorMode_Resize);
+			if (!result)
+				error = AllocatorError_OutOfMemory;
+		} break;
+		case AllocatorMode_FreeAll:
+		{
+			if (is_back)
+				DoubleArenaClearBack(da);
+			else
+				DoubleArenaClearFront(da);
+		} break;
+		case AllocatorMode_Pop:
+		{
+			if (is_back)
+			{
+				error = AllocatorError_ModeNotImplemented;
+				break;
+			}
+			uint8* ptr = (uint8*)old_ptr;
+			SafeAssert(ptr >= da->memory && ptr <= da->memory + da->front);
+			da->front = ptr - da->memory;
+		} break;
+		case AllocatorMode_QueryFeatures:
+		{
+			SafeAssert(old_ptr && ((uintptr)old_ptr & sizeof(uint32)-1) == 0);
+			uint32* features_ptr = (uint32*)old_ptr;
+			*features_ptr =
+				AllocatorFeature_Alloc |
+				AllocatorFeature_AllocNonZeroed |
+				AllocatorFeature_Resize |
+				AllocatorFeature_ResizeNonZeroed |
+				AllocatorFeature_Free |
+				AllocatorFeature_FreeAll |
+				AllocatorFeature_QueryFeatures |
+				AllocatorFeature_QueryInfo |
+				AllocatorFeature_FreeIsOptional |
+				AllocatorFeature_ResizeInPlace;
+			if (!is_back)
+				*features_ptr |= AllocatorFeature_Pop;
+		} break;
+		case AllocatorMode_QueryInfo:
+		{
+			SafeAssert(old_ptr);
+			AllocatorInfo* info = (AllocatorInfo*)old_ptr;
+			info->used = da->front + (da->size - da->back);
+			info->committed = da->size;
+			info->reserved = da->size;
+			info->thread_safe = false;
+		} break;
+		default:
+		{
+			error = AllocatorError_ModeNotImplemented;
+		} break;
+	}
+
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+	return result;
+}
+
+static void*
+DoubleArenaFrontAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{ return DoubleArenaAllocatorProc_((DoubleArena*)instance, false, mode, size, alignment, old_ptr, old_size, out_err); }
+
+static void*
+DoubleArenaBackAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{ return DoubleArenaAllocatorProc_((DoubleArena*)instance, true, mode, size, alignment, old_ptr, old_size, out_err); }
+
+static inline Allocator
+AllocatorFromDoubleArenaFront(DoubleArena* da)
+{
+	return (Allocator) {
+		.proc = DoubleArenaFrontAllocatorProc,
+		.instance = da,
+	};
+}
+
+static inline Allocator
+AllocatorFromDoubleArenaBack(DoubleArena* da)
+{
+	return (Allocator) {
+		.proc = DoubleArenaBackAllocatorProc,
+		.instance = da,
+	};
+}
+
+#endif //LJRE_BASE_DOUBLE_ARENA_H
@@ -0,0 +1,258 @@
+#ifndef LJRE_BASE_EVACUATE_H
+#define LJRE_BASE_EVACUATE_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+#include "base_hash.h"
+
+// NOTE(ljre): Copying collector for data in long-lived arenas. Everything reachable from a set of roots
+//             is copied into a fresh arena, after which the old one can be cleared or released, taking
+//             all the dead data with it.
+//
+//             The graph is walked through relocation callbacks: when an object is copied, its callback
+//             (if any) is later called on the new copy, and should evacuate each pointer field of it with
+//             EvacuatePtr(), EvacuateString(), EvacuateArray() and so on. Objects are copied only once,
+//             and any other reference to them gets the same copy, so shared data and cycles are kept.
+//             References are matched by address only: interior pointers and substrings of a bigger string
+//             get their own copy.
+//
+//                 Evacuation evac;
+//                 EvacuationBegin(&evac, &new_arena, scratch_arena);
+//                 EvacuatePtr(&evac, &cache->root, Node, EvacuateNode_);
+//                 if (EvacuationFinish(&evac))
+//                     ArenaRelease(&old_arena);
+//
+//             Callbacks should only evacuate pointers into the old arena, static data can be left alone.
+//             The forwarding table and the work list are pushed into 'temp', which only needs to live
+//             until EvacuationFinish().
+//
+//             If 'to' or 'temp' run out of memory, the fields that couldn't be evacuated keep pointing
+//             into the old arena and EvacuationFinish() returns false, so the old arena must be kept.
+#define EvacuatePtr(evac, field_ptr, Type, proc) \
+	(*(field_ptr) = (Type*)EvacuateOrKeep_(evac, *(field_ptr), 1, SignedSizeof(Type), alignof(Type), proc))
+#define EvacuateArrayPtr(evac, field_ptr, Type, count, proc) \
+	(*(field_ptr) = (Type*)EvacuateOrKeep_(evac, *(field_ptr), count, SignedSizeof(Type), alignof(Type), proc))
+
+#define EVACUATION_WORK_CHUNK_SIZE 128
+
+struct Evacuation typedef Evacuation;
+typedef void EvacuateProc(Evacuation* evac, void* object);
+
+struct EvacuationEntry
+{
+	void const* old_ptr;
+	void* new_ptr;
+	intz size;
+}
+typedef EvacuationEntry;
+
+struct EvacuationWork
+{
+	uint8* ptr;
+	intz count;
+	intz stride;
+	EvacuateProc* proc;
+}
+typedef EvacuationWork;
+
+struct EvacuationWorkChunk typedef EvacuationWorkChunk;
+struct EvacuationWorkChunk
+{
+	EvacuationWorkChunk* next;
+	intz count;
+	EvacuationWork items[EVACUATION_WORK_CHUNK_SIZE];
+};
+
+struct Evacuation
+{
+	Arena* to;
+	Arena* temp;
+
+	EvacuationEntry* table;
+	uint32 log2_of_cap;
+	intz table_count;
+
+	EvacuationWorkChunk* work;
+	EvacuationWorkChunk* free_chunks;
+
+	intz copied_bytes;
+	intz copied_count;
+	bool failed;
+};
+
+static inline void   EvacuationBegin (Evacuation* evac, Arena* to, Arena* temp);
+static inline void*  EvacuateArray   (Evacuation* evac, void const* ptr, intz count, intz elem_size, intz alignment, EvacuateProc* proc);
+static inline String EvacuateString  (Evacuation* evac, String str);
+static inline bool   EvacuationFinish(Evacuation* evac);
+
+static inline void
+EvacuationBegin(Evacuation* evac, Arena* to, Arena* temp)
+{
+	MemoryZero(evac, SignedSizeof(*evac));
+	evac->to = to;
+	evac->temp = temp;
+}
+
+static inline EvacuationEntry*
+EvacuationLookup_(Evacuation* evac, void const* ptr)
+{
+	uint64 hash = HashInt64((uint64)(uintptr)ptr);
+	intz index = (intz)hash;
+
+	for (;;)
+	{
+		index = HashMsi(evac->log2_of_cap, hash, index);
+		EvacuationEntry* entry = &evac->table[index];
+		if (!entry->old_ptr || entry->old_ptr == ptr)
+			return entry;
+	}
+}
+
+static bool
+EvacuationGrowTable_(Evacuation* evac)
+{
+	Trace();
+	uint32 new_log2 = evac->log2_of_cap ? evac->log2_of_cap + 1 : 10;
+	EvacuationEntry* new_table = ArenaPushArray(evac->temp, EvacuationEntry, (intz)1 << new_log2);
+	if (!new_table)
+		return false;
+
+	EvacuationEntry* old_table = evac->table;
+	intz old_cap = evac->log2_of_cap ? (intz)1 << evac->log2_of_cap : 0;
+	evac->table = new_table;
+	evac->log2_of_cap = new_log2;
+
+	for (intz i = 0; i < old_cap; ++i)
+	{
+		if (old_table[i].old_ptr)
+			*EvacuationLookup_(evac, old_table[i].old_ptr) = old_table[i];
+	}
+
+	return true;
+}
+
+static bool
+EvacuationPushWork_(Evacuation* evac, EvacuationWork work)
+{
+	EvacuationWorkChunk* chunk = evac->work;
+	if (!chunk || chunk->count == EVACUATION_WORK_CHUNK_SIZE)
+	{
+		chunk = evac->free_chunks;
+		if (chunk)
+			evac->free_chunks = chunk->next;
+		else
+		{
+			chunk = ArenaPushStruct(evac->temp, EvacuationWorkChunk);
+			if (!chunk)
+				return false;
+		}
+		chunk->count = 0;
+		chunk->next = evac->work;
+		evac->work = chunk;
+	}
+
+	chunk->items[chunk->count++] = work;
+	return true;
+}
+
+// NOTE(ljre): Returns the new address of 'ptr', copying it (and queueing 'proc' for each of its elements)
+//             if this is the first time it's seen. Returns NULL if 'ptr' is NULL or memory runs out, in
+//             which case the evacuation is marked as failed.
+static inline void*
+EvacuateArray(Evacuation* evac, void const* ptr, intz count, intz elem_size, intz alignment, EvacuateProc* proc)
+{
+	SafeAssert(count >= 0 && elem_size >= 0 && (!elem_size || count <= INTZ_MAX / elem_size));
+	if (!ptr)
+		return NULL;
+
+	intz size = count * elem_size;
+	if ((evac->table_count + 1) * 2 > ((intz)1 << evac->log2_of_cap))
+	{
+		if (!EvacuationGrowTable_(evac))
+		{
+			evac->failed = true;
+			return NULL;
+		}
+	}
+
+	EvacuationEntry* entry = EvacuationLookup_(evac, ptr);
+	if (entry->old_ptr && entry->size >= size)
+		return entry->new_ptr;
+
+	void* new_ptr = ArenaPushMemoryAligned(evac->to, ptr, size, alignment);
+	EvacuationWork work = { (uint8*)new_ptr, count, elem_size, proc };
+	if (!new_ptr || (proc && count && !EvacuationPushWork_(evac, work)))
+	{
+		evac->failed = true;
+		return NULL;
+	}
+
+	// NOTE(ljre): If a bigger reference shows up after a smaller one, it gets its own copy and replaces
+	//             the entry, so later references of either size share it.
+	if (!entry->old_ptr)
+		evac->table_count += 1;
+	entry->old_ptr = ptr;
+	entry->new_ptr = new_ptr;
+	entry->size = size;
+
+	evac->copied_bytes += size;
+	evac->copied_count += 1;
+	return new_ptr;
+}
+
+// NOTE(ljre): Like EvacuateArray(), but returns 'ptr' itself if it can't be evacuated.
+static inline void*
+EvacuateOrKeep_(Evacuation* evac, void const* ptr, intz count, intz elem_size, intz alignment, EvacuateProc* proc)
+{
+	void* result = EvacuateArray(evac, ptr, count, elem_size, alignment, proc);
+	return result ? result : (void*)ptr;
+}
+
+static inline String
+EvacuateString(Evacuation* evac, String str)
+{
+	String result = {
+		(uint8 const*)EvacuateOrKeep_(evac, str.data, str.size, 1, 1, NULL),
+		str.size,
+	};
+
+	return result;
+}
+
+// NOTE(ljre): Returns false if anything couldn't be evacuated, in which case the old arena is still in use.
+static inline bool
+EvacuationFinish(Evacuation* evac)
+{
+	Trace();
+	while (evac->work)
+	{
+		EvacuationWorkChunk* chunk = evac->work;
+		if (!chunk->count)
+		{
+			evac->work = chunk->next;
+			chunk->next = evac->free_chunks;
+			evac->free_chunks = chunk;
+			continue;
+		}
+
+		// NOTE(ljre): The callback might push more work, so take the item out first.
+		EvacuationWork work = chunk->items[--chunk->count];
+		for (intz i = 0; i < work.count; ++i)
+			work.proc(evac, work.ptr + i * work.stride);
+	}
+
+	return !evac->failed;
+}
+
+#ifdef __cplusplus
+template <typename T>
+static inline Slice<T>
+EvacuateSlice(Evacuation* evac, Slice<T> slice, EvacuateProc* proc)
+{
+	T* data = (T*)EvacuateOrKeep_(evac, slice.data, slice.count, SignedSizeof(T), alignof(T), proc);
+	return { data, slice.count };
+}
+#endif //__cplusplus
+
+#endif //LJRE_BASE_EVACUATE_H
@@ -0,0 +1,119 @@
+#ifndef LJRE_BASE_FRAME_ARENA_H
+#define LJRE_BASE_FRAME_ARENA_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+
+#ifndef CONFIG_FRAME_ARENA_MAX_COUNT
+#	define CONFIG_FRAME_ARENA_MAX_COUNT 4
+#endif
+
+static_assert(CONFIG_FRAME_ARENA_MAX_COUNT >= 2, "frame arenas need at least 2 arenas to rotate");
+
+// NOTE(ljre): Ring of arenas for work done in frames (or requests). FrameArenasBegin() moves to the next
+//             arena in the ring and clears it, so memory pushed during a frame stays valid for count-1
+//             more frames, and tearing a frame down is a single ArenaClear().
+//
+//             Data that needs to live longer is copied out: FramePromote*() copies it into the long-lived
+//             'persistent' arena, and FrameCarry*() copies it into the current frame, which renews it for
+//             another count-1 frames.
+#define FramePromoteStruct(frames, Type, ptr) \
+	((Type*)FramePromoteMemory(frames, ptr, SignedSizeof(Type), alignof(Type)))
+#define FrameCarryStruct(frames, Type, ptr) \
+	((Type*)FrameCarryMemory(frames, ptr, SignedSizeof(Type), alignof(Type)))
+
+struct FrameArenas
+{
+	Arena arenas[CONFIG_FRAME_ARENA_MAX_COUNT];
+	int32 count;
+	int32 current;
+	int64 frame_index;
+	Arena* persistent;
+}
+typedef FrameArenas;
+
+static inline bool   FrameArenasInit    (FrameArenas* frames, int32 count, intz reserve_size, Arena* persistent);
+static inline void   FrameArenasRelease (FrameArenas* frames);
+static inline Arena* FrameArenasBegin   (FrameArenas* frames);
+static inline Arena* FrameArenaCurrent  (FrameArenas* frames);
+static inline Arena* FrameArenaPrevious (FrameArenas* frames);
+static inline String FramePromoteString (FrameArenas* frames, String str);
+static inline void*  FramePromoteMemory (FrameArenas* frames, void const* ptr, intz size, intz alignment);
+static inline String FrameCarryString   (FrameArenas* frames, String str);
+static inline void*  FrameCarryMemory   (FrameArenas* frames, void const* ptr, intz size, intz alignment);
+
+static inline bool
+FrameArenasInit(FrameArenas* frames, int32 count, intz reserve_size, Arena* persistent)
+{
+	Trace();
+	SafeAssert(count >= 2 && count <= CONFIG_FRAME_ARENA_MAX_COUNT);
+	MemoryZero(frames, SignedSizeof(*frames));
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		frames->arenas[i] = ArenaReserve(reserve_size, 0);
+		if (!frames->arenas[i].memory)
+		{
+			for (int32 j = 0; j < i; ++j)
+				ArenaRelease(&frames->arenas[j]);
+			return false;
+		}
+	}
+
+	frames->count = count;
+	frames->persistent = persistent;
+	return true;
+}
+
+static inline void
+FrameArenasRelease(FrameArenas* frames)
+{
+	Trace();
+	for (int32 i = 0; i < frames->count; ++i)
+		ArenaRelease(&frames->arenas[i]);
+	frames->count = 0;
+}
+
+static inline Arena*
+FrameArenasBegin(FrameArenas* frames)
+{
+	frames->current = (frames->current + 1 == frames->count) ? 0 : frames->current + 1;
+	frames->frame_index += 1;
+
+	Arena* arena = &frames->arenas[frames->current];
+	ArenaClear(arena);
+	return arena;
+}
+
+static inline Arena*
+FrameArenaCurrent(FrameArenas* frames)
+{ return &frames->arenas[frames->current]; }
+
+static inline Arena*
+FrameArenaPrevious(FrameArenas* frames)
+{ return &frames->arenas[(frames->current == 0) ? frames->count - 1 : frames->current - 1]; }
+
+static inline String
+FramePromoteString(FrameArenas* frames, String str)
+{
+	Assert(frames->persistent);
+	return ArenaPushString(frames->persistent, str);
+}
+
+static inline void*
+FramePromoteMemory(FrameArenas* frames, void const* ptr, intz size, intz alignment)
+{
+	Assert(frames->persistent);
+	return ArenaPushMemoryAligned(frames->persistent, ptr, size, alignment);
+}
+
+static inline String
+FrameCarryString(FrameArenas* frames, String str)
+{ return ArenaPushString(FrameArenaCurrent(frames), str); }
+
+static inline void*
+FrameCarryMemory(FrameArenas* frames, void const* ptr, intz size, intz alignment)
+{ return ArenaPushMemoryAligned(FrameArenaCurrent(frames), ptr, size, alignment); }
+
+#endif //LJRE_BASE_FRAME_ARENA_H
@@ -21,6 +21,7 @@ static inline FORCE_INLINE uint32 ByteSwap32(uint32 x);
 static inline FORCE_INLINE uint16 ByteSwap16(uint16 x);
 static inline FORCE_INLINE uint16  EncodeF16(float32 x);
 static inline FORCE_INLINE float32 DecodeF16(uint16 x);
+static inline FORCE_INLINE uint64 ReadCycleCounter(void);
 static inline intz MemoryStrlen(char const* restrict cstr);
 static inline intz MemoryStrnlen(char const* restrict cstr, intz limit);
 static inline int32 MemoryStrcmp(char const* left, char const* right);
@@ -325,6 +326,10 @@ DecodeF16(uint16 x)
 	return cvt.f;
 }
 
+static inline FORCE_INLINE uint64
+ReadCycleCounter(void)
+{ return __rdtsc(); }
+
 #elif defined(CONFIG_ARCH_ARMFAMILY)
 //~ NOTE(ljre): ARM
 #ifdef CONFIG_ARCH_AARCH64
@@ -375,6 +380,22 @@ MemoryCopyX16(void* restrict dst, const void* restrict src)
 }
 #endif //CONFIG_ARCH_AARCH64
 
+// NOTE(ljre): On AArch64 this is the generic timer, which ticks slower than the CPU clock. ARMv7 doesn't
+//             let userspace read the cycle counter by default.
+#ifdef CONFIG_ARCH_AARCH64
+static inline FORCE_INLINE uint64
+ReadCycleCounter(void)
+{
+	uint64 result;
+	__asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r"(result));
+	return result;
+}
+#else //CONFIG_ARCH_AARCH64
+static inline FORCE_INLINE uint64
+ReadCycleCounter(void)
+{ return 0; }
+#endif //CONFIG_ARCH_AARCH64
+
 #else //CONFIG_ARCH_*
 #	error "Unknown architecture"
 #endif //CONFIG_ARCH_*
@@ -0,0 +1,270 @@
+#ifndef LJRE_BASE_RECYCLING_ARENA_H
+#define LJRE_BASE_RECYCLING_ARENA_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+
+// NOTE(ljre): Opt-in wrapper over an Arena for long-lived arenas that see frees and resizes out of stack
+//             order. A plain arena leaks every block that isn't at its tip when it's freed or moved by a
+//             resize; this one puts those blocks in per-size-class free lists and hands them out again.
+//
+//             Sizes are rounded up to a size class (4 classes per power of 2, so at most 25% is lost to
+//             rounding) so that any block in a list fits any request of its class. Blocks at the tip are
+//             still popped or resized in place. Sizes above RECYCLING_ARENA_MAX_SIZE go straight to the
+//             arena and are never recycled.
+//
+//             The free lists point into the arena, so don't ArenaRestore()/ArenaClear() it behind this
+//             wrapper's back. Use RecyclingArenaClear() (or AllocatorMode_FreeAll) instead.
+#define RECYCLING_ARENA_MIN_SIZE 16
+#define RECYCLING_ARENA_MAX_SIZE ((intz)1 << 32)
+#define RECYCLING_ARENA_CLASS_COUNT (1 + (32 - 4) * 4)
+
+struct RecyclingArena
+{
+	Arena* arena;
+	void* free_lists[RECYCLING_ARENA_CLASS_COUNT];
+
+	intz free_bytes;    // bytes currently sitting in the free lists
+	int64 reuse_count;  // allocations served from the free lists
+}
+typedef RecyclingArena;
+
+static inline void  RecyclingArenaInit  (RecyclingArena* ra, Arena* arena);
+static inline void  RecyclingArenaClear (RecyclingArena* ra);
+static inline void* RecyclingArenaAlloc (RecyclingArena* ra, intz size, intz alignment, bool zeroed);
+static inline void  RecyclingArenaFree  (RecyclingArena* ra, void* ptr, intz size);
+static inline void* RecyclingArenaResize(RecyclingArena* ra, void* old_ptr, intz old_size, intz size, intz alignment, bool zeroed);
+
+static inline int32 RecyclingArenaSizeClass_    (intz size);
+static inline intz  RecyclingArenaSizeFromClass_(int32 size_class);
+
+static inline Allocator AllocatorFromRecyclingArena(RecyclingArena* ra);
+
+// NOTE(ljre): Class 0 is everything up to 16 bytes, then 4 classes per power of 2.
+static inline int32
+RecyclingArenaSizeClass_(intz size)
+{
+	SafeAssert(size >= 0 && size <= RECYCLING_ARENA_MAX_SIZE);
+
+	if (size <= RECYCLING_ARENA_MIN_SIZE)
+		return 0;
+
+	int32 msb = 63 - BitClz64((uint64)(size - 1));
+	return 1 + (msb - 4) * 4 + (int32)((size - 1 - ((intz)1 << msb)) >> (msb - 2));
+}
+
+static inline intz
+RecyclingArenaSizeFromClass_(int32 size_class)
+{
+	SafeAssert(size_class >= 0 && size_class < RECYCLING_ARENA_CLASS_COUNT);
+
+	if (size_class == 0)
+		return RECYCLING_ARENA_MIN_SIZE;
+
+	intz base = (intz)RECYCLING_ARENA_MIN_SIZE << ((size_class - 1) / 4);
+	return base + ((size_class - 1) % 4 + 1) * (base / 4);
+}
+
+static inline void
+RecyclingArenaInit(RecyclingArena* ra, Arena* arena)
+{
+	MemoryZero(ra, SignedSizeof(*ra));
+	ra->arena = arena;
+}
+
+static inline void
+RecyclingArenaClear(RecyclingArena* ra)
+{
+	ArenaClear(ra->arena);
+	MemoryZero(ra->free_lists, SignedSizeof(ra->free_lists));
+	ra->free_bytes = 0;
+}
+
+// NOTE(ljre): The size a block of 'size' bytes really takes, which is what Free and Resize look at.
+static inline intz
+RecyclingArenaBlockSize_(intz size)
+{
+	if (size > RECYCLING_ARENA_MAX_SIZE)
+		return size;
+	return RecyclingArenaSizeFromClass_(RecyclingArenaSizeClass_(size));
+}
+
+static inline void*
+RecyclingArenaAlloc(RecyclingArena* ra, intz size, intz alignment, bool zeroed)
+{
+	Assert(alignment != 0 && IsPowerOf2(alignment));
+	SafeAssert(size >= 0);
+
+	void* result = NULL;
+	intz block_size = RecyclingArenaBlockSize_(size);
+
+	if (size <= RECYCLING_ARENA_MAX_SIZE)
+	{
+		void** list = &ra->free_lists[RecyclingArenaSizeClass_(size)];
+		void* head = *list;
+
+		// NOTE(ljre): Only the head is looked at. If it isn't aligned enough, just push a new block.
+		if (head && ((uintptr)head & (uintptr)alignment-1) == 0)
+		{
+			*list = *(void**)head;
+			ra->free_bytes -= block_size;
+			ra->reuse_count += 1;
+			result = head;
+		}
+	}
+
+	if (!result)
+	{
+		// NOTE(ljre): Blocks need to hold the free list link once they're freed.
+		result = ArenaPushDirtyAligned(ra->arena, block_size, Max(alignment, (intz)alignof(void*)));
+		if (!result)
+			return NULL;
+	}
+
+	if (zeroed)
+		MemoryZero(result, size);
+	return result;
+}
+
+static inline void
+RecyclingArenaFree(RecyclingArena* ra, void* ptr, intz size)
+{
+	if (!ptr)
+		return;
+
+	Arena* arena = ra->arena;
+	intz block_size = RecyclingArenaBlockSize_(size);
+
+	if (ArenaBlockContains_(arena, ptr) && (uint8*)ptr + block_size == (uint8*)ArenaEnd(arena))
+		ArenaPop(arena, ptr);
+	else if (size <= RECYCLING_ARENA_MAX_SIZE)
+	{
+		Trace();
+		void** list = &ra->free_lists[RecyclingArenaSizeClass_(size)];
+		*(void**)ptr = *list;
+		*list = ptr;
+		ra->free_bytes += block_size;
+	}
+}
+
+static inline void*
+RecyclingArenaResize(RecyclingArena* ra, void* old_ptr, intz old_size, intz size, intz alignment, bool zeroed)
+{
+	Assert(alignment != 0 && IsPowerOf2(alignment));
+	SafeAssert(size >= 0 && old_size >= 0);
+
+	if (!old_ptr)
+		return RecyclingArenaAlloc(ra, size, alignment, zeroed);
+
+	intz old_block_size = RecyclingArenaBlockSize_(old_size);
+	intz block_size = RecyclingArenaBlockSize_(size);
+	void* result = NULL;
+
+	if (old_block_size == block_size || ArenaResizeTip_(ra->arena, old_ptr, old_block_size, block_size, false))
+		result = old_ptr;
+	else
+	{
+		Trace();
+		result = RecyclingArenaAlloc(ra, size, alignment, false);
+		if (!result)
+			return NULL;
+		MemoryCopy(result, old_ptr, Min(size, old_size));
+		RecyclingArenaFree(ra, old_ptr, old_size);
+	}
+
+	if (zeroed && size > old_size)
+		MemoryZero((uint8*)result + old_size, size - old_size);
+	return result;
+}
+
+static void*
+RecyclingArenaAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	Trace();
+	void* result = NULL;
+	AllocatorError error = AllocatorError_Ok;
+	RecyclingArena* ra = (RecyclingArena*)instance;
+
+	bool is_invalid_alignment = (!alignment || (alignment & alignment-1) != 0);
+
+	switch (mode)
+	{
+		case AllocatorMode_Alloc:
+		case AllocatorMode_AllocNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			result = RecyclingArenaAlloc(ra, size, alignment, mode == AllocatorMode_Alloc);
+			if (!result)
+				error = AllocatorError_OutOfMemory;
+		} break;
+		case AllocatorMode_Free:
+		{
+			SafeAssert(old_size >= 0);
+			RecyclingArenaFree(ra, old_ptr, old_size);
+		} break;
+		case AllocatorMode_Resize:
+		case AllocatorMode_ResizeNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0 || old_size < 0)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			result = RecyclingArenaResize(ra, old_ptr, old_size, size, alignment, mode == AllocatorMode_Resize);
+			if (!result)
+				error = AllocatorError_OutOfMemory;
+		} break;
+		case AllocatorMode_FreeAll:
+		{
+			RecyclingArenaClear(ra);
+		} break;
+		case AllocatorMode_QueryFeatures:
+		{
+			SafeAssert(old_ptr && ((uintptr)old_ptr & sizeof(uint32)-1) == 0);
+			uint32* features_ptr = (uint32*)old_ptr;
+			*features_ptr =
+				AllocatorFeature_Alloc |
+				AllocatorFeature_AllocNonZeroed |
+				AllocatorFeature_Resize |
+				AllocatorFeature_ResizeNonZeroed |
+				AllocatorFeature_Free |
+				AllocatorFeature_FreeAll |
+				AllocatorFeature_QueryFeatures |
+				AllocatorFeature_QueryInfo |
+				AllocatorFeature_ResizeInPlace;
+		} break;
+		case AllocatorMode_QueryInfo:
+		{
+			SafeAssert(old_ptr);
+			AllocatorInfo* info = (AllocatorInfo*)old_ptr;
+			ArenaAllocatorProc(ra->arena, AllocatorMode_QueryInfo, 0, 0, info, 0, NULL);
+			info->used -= ra->free_bytes;
+		} break;
+		default:
+		{
+			error = AllocatorError_ModeNotImplemented;
+		} break;
+	}
+
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+	return result;
+}
+
+static inline Allocator
+AllocatorFromRecyclingArena(RecyclingArena* ra)
+{
+	return (Allocator) {
+		.proc = RecyclingArenaAllocatorProc,
+		.instance = ra,
+	};
+}
+
+#endif //LJRE_BASE_RECYCLING_ARENA_H
@@ -0,0 +1,161 @@
+#ifndef LJRE_BASE_RELPTR_H
+#define LJRE_BASE_RELPTR_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+
+// NOTE(ljre): Position independent pointers, for data that gets mapped at different addresses (files,
+//             shared memory, see ArenaFromFile()) or moved around as a whole with MemoryCopy().
+//
+//             Relative pointers store the distance from their own address to the target, so they stay
+//             valid as long as they move together with what they point to. 0 is NULL, so zeroed memory
+//             is full of NULL pointers, which also means a relative pointer can't point at itself (e.g. a
+//             struct whose first field points back to the struct). Copying one somewhere else by itself
+//             breaks it: use RelPtrSet() with RelPtrGet() of the original instead (the C++ RelPtr<T> does
+//             this when copied).
+//
+//             Arena handles are 32-bit offsets from the start of a (non-chained) arena, plus one so that
+//             0 is NULL. They need the arena to be turned back into pointers, but are half the size.
+//
+//             In C, declare relative pointers with RelPtrOf(Type). The type is only there for the reader:
+//                 struct Node { RelPtrOf(Node) next; RelString name; };
+//                 RelPtrSet(&node->next, other_node);
+//                 Node* next = RelPtrGet(&node->next);
+#define RelPtrOf(Type) struct { int64 offset; }
+#define RelPtrSet(rel, target) RelPtrSet_(&(rel)->offset, (target))
+#define RelPtrGet(rel) RelPtrGet_(&(rel)->offset)
+
+struct RelString
+{
+	int64 offset;
+	intz size;
+}
+typedef RelString;
+
+typedef uint32 ArenaHandle;
+
+static inline void   RelPtrSet_   (int64* rel, void const* target);
+static inline void*  RelPtrGet_   (int64 const* rel);
+static inline void   RelStringSet (RelString* rel, String str);
+static inline String RelStringGet (RelString const* rel);
+
+static inline ArenaHandle ArenaHandleFromPtr(Arena* arena, void const* ptr);
+static inline void*       ArenaPtrFromHandle(Arena* arena, ArenaHandle handle);
+
+static inline void
+RelPtrSet_(int64* rel, void const* target)
+{
+	SafeAssert(target != rel);
+	*rel = target ? (int64)((intptr)target - (intptr)rel) : 0;
+}
+
+static inline void*
+RelPtrGet_(int64 const* rel)
+{
+	int64 offset = *rel;
+	return offset ? (void*)((intptr)rel + (intptr)offset) : NULL;
+}
+
+static inline void
+RelStringSet(RelString* rel, String str)
+{
+	RelPtrSet_(&rel->offset, str.data);
+	rel->size = str.size;
+}
+
+static inline String
+RelStringGet(RelString const* rel)
+{
+	String result = {
+		(uint8 const*)RelPtrGet_(&rel->offset),
+		rel->size,
+	};
+
+	return result;
+}
+
+static inline ArenaHandle
+ArenaHandleFromPtr(Arena* arena, void const* ptr)
+{
+	if (!ptr)
+		return 0;
+
+	Assert(!(arena->flags & ArenaFlags_Chained));
+	intz offset = (uint8 const*)ptr - arena->memory;
+	SafeAssert(offset >= 0 && offset <= arena->offset && offset < (intz)UINT32_MAX);
+
+	return (ArenaHandle)offset + 1;
+}
+
+static inline void*
+ArenaPtrFromHandle(Arena* arena, ArenaHandle handle)
+{
+	if (!handle)
+		return NULL;
+
+	Assert(!(arena->flags & ArenaFlags_Chained));
+	SafeAssert((intz)handle - 1 <= arena->offset);
+
+	return arena->memory + (handle - 1);
+}
+
+#ifdef __cplusplus
+template <typename T>
+struct RelPtr
+{
+	int64 offset;
+
+	inline RelPtr() : offset(0) {}
+	inline RelPtr(T* ptr) { Set(ptr); }
+	inline RelPtr(RelPtr const& other) { Set(other.Get()); }
+	inline RelPtr& operator=(RelPtr const& other) { Set(other.Get()); return *this; }
+	inline RelPtr& operator=(T* ptr) { Set(ptr); return *this; }
+
+	inline void Set(T* ptr) { RelPtrSet_(&offset, ptr); }
+	inline T* Get() const { return (T*)RelPtrGet_(&offset); }
+
+	inline T* operator->() const { return Get(); }
+	inline T& operator*() const { return *Get(); }
+	inline operator T*() const { return Get(); }
+	inline explicit operator bool() const { return offset != 0; }
+};
+
+template <typename T>
+struct RelSlice
+{
+	RelPtr<T> data;
+	intz count;
+
+	inline RelSlice() : count(0) {}
+	inline RelSlice(Slice<T> slice) { Set(slice); }
+	inline RelSlice& operator=(Slice<T> slice) { Set(slice); return *this; }
+
+	inline void Set(Slice<T> slice) { data.Set(slice.data); count = slice.count; }
+	inline Slice<T> Get() const { return { data.Get(), count }; }
+
+	inline operator Slice<T>() const { return Get(); }
+	inline T& operator[](intz index) const { return Get()[index]; }
+	inline T* begin() const { return data.Get(); }
+	inline T* end() const { return data.Get() + count; }
+};
+
+template <typename T>
+struct ArenaRef
+{
+	ArenaHandle handle;
+
+	static inline ArenaRef From(Arena* arena, T* ptr) { return { ArenaHandleFromPtr(arena, ptr) }; }
+	inline T* Get(Arena* arena) const { return (T*)ArenaPtrFromHandle(arena, handle); }
+	inline explicit operator bool() const { return handle != 0; }
+};
+
+static inline void
+RelStringSet(RelString* rel, Slice<uint8 const> slice)
+{
+	RelPtrSet_(&rel->offset, slice.data);
+	rel->size = slice.count;
+}
+#endif //__cplusplus
+
+#endif //LJRE_BASE_RELPTR_H
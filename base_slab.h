@@ -0,0 +1,310 @@
+#ifndef LJRE_BASE_SLAB_H
+#define LJRE_BASE_SLAB_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+
+#ifndef CONFIG_SLAB_DEFAULT_SIZE
+#	define CONFIG_SLAB_DEFAULT_SIZE (64 << 10)
+#endif
+
+// NOTE(ljre): Allocator for objects of a single size. Objects are bumped out of page-granular slabs, and
+//             freed objects go to an intrusive free list, so Alloc, Free and FreeAll are all O(1).
+//             Slabs are pushed from 'arena' if given, or else taken straight from the OS. FreeAll keeps the
+//             slabs around and starts bumping from the first one again.
+struct SlabHeader typedef SlabHeader;
+struct SlabHeader
+{
+	SlabHeader* next;
+};
+
+struct SlabAllocator
+{
+	intz object_size;
+	intz object_alignment;
+	intz slab_size;
+	Arena* arena;
+
+	SlabHeader* first_slab;
+	SlabHeader* current_slab;
+	uint8* bump;
+	uint8* bump_end;
+	void* free_list;
+
+	intz slab_count;
+	intz live_count;
+}
+typedef SlabAllocator;
+
+API intz  SlabPageSize_     (void);
+API void* SlabAllocatePages_(intz size);
+API void  SlabFreePages_    (void* ptr, intz size);
+
+static inline SlabAllocator SlabAllocatorCreate (Arena* arena, intz object_size, intz object_alignment, intz slab_size);
+static inline void          SlabAllocatorRelease(SlabAllocator* slab);
+static inline void*         SlabAlloc           (SlabAllocator* slab);
+static inline void          SlabFree            (SlabAllocator* slab, void* ptr);
+static inline void          SlabFreeAll         (SlabAllocator* slab);
+
+static inline Allocator AllocatorFromSlab(SlabAllocator* slab);
+
+static inline SlabAllocator
+SlabAllocatorCreate(Arena* arena, intz object_size, intz object_alignment, intz slab_size)
+{
+	SafeAssert(object_size > 0 && slab_size >= 0);
+	Assert(object_alignment != 0 && IsPowerOf2(object_alignment));
+
+	// NOTE(ljre): Free objects hold the free list link, so they need to fit (and be aligned for) a pointer.
+	object_alignment = Max(object_alignment, (intz)alignof(void*));
+	object_size = AlignUp(Max(object_size, SignedSizeof(void*)), object_alignment-1);
+
+	if (!slab_size)
+		slab_size = CONFIG_SLAB_DEFAULT_SIZE;
+	slab_size = AlignUp(Max(slab_size, AlignUp(SignedSizeof(SlabHeader), object_alignment-1) + object_size), SlabPageSize_()-1);
+
+	SlabAllocator result = {
+		.object_size = object_size,
+		.object_alignment = object_alignment,
+		.slab_size = slab_size,
+		.arena = arena,
+	};
+
+	return result;
+}
+
+static inline void
+SlabAllocatorRelease(SlabAllocator* slab)
+{
+	Trace();
+	if (!slab->arena)
+	{
+		for (SlabHeader* it = slab->first_slab; it;)
+		{
+			SlabHeader* next = it->next;
+			SlabFreePages_(it, slab->slab_size);
+			it = next;
+		}
+	}
+
+	slab->first_slab = NULL;
+	slab->current_slab = NULL;
+	slab->bump = NULL;
+	slab->bump_end = NULL;
+	slab->free_list = NULL;
+	slab->slab_count = 0;
+	slab->live_count = 0;
+}
+
+static inline void
+SlabBeginBumping_(SlabAllocator* slab, SlabHeader* header)
+{
+	slab->current_slab = header;
+	slab->bump = (uint8*)AlignUp((uintptr)(header + 1), (uintptr)slab->object_alignment-1);
+	slab->bump_end = (uint8*)header + slab->slab_size;
+}
+
+static void*
+SlabAllocSlow_(SlabAllocator* slab)
+{
+	Trace();
+	SlabHeader* header = slab->current_slab ? slab->current_slab->next : slab->first_slab;
+
+	if (!header)
+	{
+		if (slab->arena)
+			header = (SlabHeader*)ArenaPushDirtyAligned(slab->arena, slab->slab_size, Max(slab->object_alignment, (intz)alignof(SlabHeader)));
+		else
+			header = (SlabHeader*)SlabAllocatePages_(slab->slab_size);
+		if (!header)
+			return NULL;
+
+		header->next = NULL;
+		slab->slab_count += 1;
+		if (slab->current_slab)
+			slab->current_slab->next = header;
+		else
+			slab->first_slab = header;
+	}
+
+	SlabBeginBumping_(slab, header);
+
+	void* result = slab->bump;
+	slab->bump += slab->object_size;
+	slab->live_count += 1;
+	return result;
+}
+
+static inline void*
+SlabAlloc(SlabAllocator* slab)
+{
+	void* result = slab->free_list;
+
+	if (result)
+		slab->free_list = *(void**)result;
+	else if (Likely(slab->bump_end - slab->bump >= slab->object_size))
+	{
+		result = slab->bump;
+		slab->bump += slab->object_size;
+	}
+	else
+		return SlabAllocSlow_(slab);
+
+	slab->live_count += 1;
+	return result;
+}
+
+static inline void
+SlabFree(SlabAllocator* slab, void* ptr)
+{
+	if (!ptr)
+		return;
+	*(void**)ptr = slab->free_list;
+	slab->free_list = ptr;
+	slab->live_count -= 1;
+}
+
+static inline void
+SlabFreeAll(SlabAllocator* slab)
+{
+	slab->free_list = NULL;
+	slab->live_count = 0;
+
+	if (slab->first_slab)
+		SlabBeginBumping_(slab, slab->first_slab);
+}
+
+static void*
+SlabAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	Trace();
+	void* result = NULL;
+	AllocatorError error = AllocatorError_Ok;
+	SlabAllocator* slab = (SlabAllocator*)instance;
+
+	bool is_invalid_alignment = (!alignment || (alignment & alignment-1) != 0 || alignment > slab->object_alignment);
+
+	switch (mode)
+	{
+		case AllocatorMode_Alloc:
+		case AllocatorMode_AllocNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0 || size > slab->object_size)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			result = SlabAlloc(slab);
+			if (!result)
+				error = AllocatorError_OutOfMemory;
+			else if (mode == AllocatorMode_Alloc)
+				MemoryZero(result, size);
+		} break;
+		case AllocatorMode_Free:
+		{
+			SafeAssert(old_size <= slab->object_size);
+			SlabFree(slab, old_ptr);
+		} break;
+		case AllocatorMode_Resize:
+		case AllocatorMode_ResizeNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0 || size > slab->object_size)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+
+			result = old_ptr ? old_ptr : SlabAlloc(slab);
+			if (!result)
+			{
+				error = AllocatorError_OutOfMemory;
+				break;
+			}
+
+			intz kept_size = old_ptr ? old_size : 0;
+			if (mode == AllocatorMode_Resize && size > kept_size)
+				MemoryZero((uint8*)result + kept_size, size - kept_size);
+		} break;
+		case AllocatorMode_FreeAll:
+		{
+			SlabFreeAll(slab);
+		} break;
+		case AllocatorMode_QueryFeatures:
+		{
+			SafeAssert(old_ptr && ((uintptr)old_ptr & sizeof(uint32)-1) == 0);
+			uint32* features_ptr = (uint32*)old_ptr;
+			*features_ptr =
+				AllocatorFeature_Alloc |
+				AllocatorFeature_AllocNonZeroed |
+				AllocatorFeature_Resize |
+				AllocatorFeature_ResizeNonZeroed |
+				AllocatorFeature_Free |
+				AllocatorFeature_FreeAll |
+				AllocatorFeature_AllocBatch |
+				AllocatorFeature_FreeBatch |
+				AllocatorFeature_QueryFeatures |
+				AllocatorFeature_QueryInfo |
+				AllocatorFeature_ResizeInPlace;
+		} break;
+		case AllocatorMode_QueryInfo:
+		{
+			SafeAssert(old_ptr);
+			AllocatorInfo* info = (AllocatorInfo*)old_ptr;
+			info->used = slab->live_count * slab->object_size;
+			info->committed = slab->slab_count * slab->slab_size;
+			info->reserved = info->committed;
+			info->thread_safe = false;
+		} break;
+		case AllocatorMode_AllocBatch:
+		{
+			void** ptrs = (void**)old_ptr;
+			if (is_invalid_alignment || size < 0 || old_size < 0 || (!ptrs && old_size) || size > slab->object_size)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+
+			for (intz i = 0; i < old_size; ++i)
+			{
+				ptrs[i] = SlabAlloc(slab);
+				if (!ptrs[i])
+				{
+					while (i-- > 0)
+						SlabFree(slab, ptrs[i]);
+					error = AllocatorError_OutOfMemory;
+					break;
+				}
+				MemoryZero(ptrs[i], size);
+			}
+			if (!error)
+				result = ptrs;
+		} break;
+		case AllocatorMode_FreeBatch:
+		{
+			void** ptrs = (void**)old_ptr;
+			for (intz i = 0; i < old_size; ++i)
+				SlabFree(slab, ptrs[i]);
+		} break;
+		default:
+		{
+			error = AllocatorError_ModeNotImplemented;
+		} break;
+	}
+
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+	return result;
+}
+
+static inline Allocator
+AllocatorFromSlab(SlabAllocator* slab)
+{
+	return (Allocator) {
+		.proc = SlabAllocatorProc,
+		.instance = slab,
+	};
+}
+
+#endif //LJRE_BASE_SLAB_H
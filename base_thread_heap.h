@@ -0,0 +1,234 @@
+#ifndef LJRE_BASE_THREAD_HEAP_H
+#define LJRE_BASE_THREAD_HEAP_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+#include "base_concurrent_arena.h"
+#include "base_tlsf.h"
+
+#ifndef CONFIG_THREAD_HEAP_SPAN_SIZE
+#	define CONFIG_THREAD_HEAP_SPAN_SIZE (64 << 10)
+#endif
+
+static_assert(CONFIG_THREAD_HEAP_SPAN_SIZE >= (16 << 10) && IsPowerOf2(CONFIG_THREAD_HEAP_SPAN_SIZE), "span size needs to be a power of 2 that fits the biggest size class");
+
+// NOTE(ljre): Heap for many threads. Small allocations (up to THREAD_HEAP_MAX_SMALL_SIZE bytes) are
+//             rounded up to one of THREAD_HEAP_CLASS_COUNT size classes and served from spans of
+//             CONFIG_THREAD_HEAP_SPAN_SIZE bytes owned by the calling thread, through a cache kept in its
+//             ThreadContext. No locks or atomics are involved unless the thread runs out of spans.
+//
+//             Freeing an object owned by another thread pushes it into that span's remote free list with a
+//             single CAS. The owner takes the whole list back with one exchange when it runs out of room.
+//
+//             Bigger allocations, and ones aligned to more than 16 bytes, go to a TlsfHeap behind a lock.
+//
+//             Before a thread that used the heap exits, it must call ThreadCachingHeapReleaseThreadCache().
+//             Its spans are then adopted by other threads as they need new ones. The caches live in the
+//             heap's memory, so every thread other than the one calling ThreadCachingHeapRelease() must
+//             also have released its cache by then.
+#define THREAD_HEAP_CLASS_COUNT 32
+#define THREAD_HEAP_MAX_SMALL_SIZE 8192
+#define THREAD_HEAP_SMALL_ALIGNMENT 16
+
+struct ThreadCachingHeap typedef ThreadCachingHeap;
+
+struct ThreadHeapSpan typedef ThreadHeapSpan;
+struct ThreadHeapSpan
+{
+	ThreadHeapCache* owner; // NULL when abandoned
+	ThreadHeapSpan* next;
+	void* free_list;
+	uint8* bump;
+	uint8* end;
+	int32 size_class;
+	int32 object_size;
+
+	alignas(CONFIG_CACHELINE_SIZE) void* remote_free;
+};
+
+struct ThreadHeapCache
+{
+	ThreadCachingHeap* heap;
+	ThreadHeapCache* next; // next cache of this thread, or next free cache of the heap
+
+	ThreadHeapSpan* available[THREAD_HEAP_CLASS_COUNT];
+	ThreadHeapSpan* full[THREAD_HEAP_CLASS_COUNT];
+};
+
+struct ThreadCachingHeap
+{
+	ConcurrentArena spans;
+
+	// NOTE(ljre): Everything below is protected by the lock.
+	alignas(CONFIG_CACHELINE_SIZE) int32 lock;
+	ThreadHeapSpan* abandoned[THREAD_HEAP_CLASS_COUNT];
+	ThreadHeapCache* free_caches;
+	intz live_caches;
+	Arena large_arena;
+	TlsfHeap large;
+};
+
+API bool  ThreadCachingHeapInit   (ThreadCachingHeap* heap, intz reserve_size);
+API void  ThreadCachingHeapRelease(ThreadCachingHeap* heap);
+API void* ThreadCachingHeapAlloc  (ThreadCachingHeap* heap, intz size, intz alignment);
+API void* ThreadCachingHeapResize (ThreadCachingHeap* heap, void* ptr, intz old_size, intz size, intz alignment);
+API void  ThreadCachingHeapFree   (ThreadCachingHeap* heap, void* ptr);
+API void  ThreadCachingHeapReleaseThreadCache(ThreadCachingHeap* heap);
+API void  ThreadCachingHeapQueryInfo(ThreadCachingHeap* heap, AllocatorInfo* out_info);
+API bool  ThreadCachingHeapSetBudget(ThreadCachingHeap* heap, MemoryBudget* budget); // see ArenaSetBudget()
+
+static inline int32 ThreadHeapSizeClass    (intz size);
+static inline intz  ThreadHeapSizeFromClass(int32 size_class);
+
+static inline Allocator AllocatorFromThreadCachingHeap(ThreadCachingHeap* heap);
+
+// NOTE(ljre): Classes go in steps of 16 bytes up to 128, then in 4 steps per power of 2 up to 8 KiB.
+static inline int32
+ThreadHeapSizeClass(intz size)
+{
+	SafeAssert(size >= 0 && size <= THREAD_HEAP_MAX_SMALL_SIZE);
+
+	if (size <= 128)
+		return (int32)(Max(size, 1) + 15) / 16 - 1;
+
+	int32 msb = 63 - BitClz64((uint64)(size - 1));
+	return 8 + (msb - 7) * 4 + (int32)((size - 1 - ((intz)1 << msb)) >> (msb - 2));
+}
+
+static inline intz
+ThreadHeapSizeFromClass(int32 size_class)
+{
+	SafeAssert(size_class >= 0 && size_class < THREAD_HEAP_CLASS_COUNT);
+
+	if (size_class < 8)
+		return (size_class + 1) * 16;
+
+	intz base = (intz)128 << ((size_class - 8) / 4);
+	return base + ((size_class - 8) % 4 + 1) * (base / 4);
+}
+
+static void*
+ThreadCachingHeapAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	Trace();
+	void* result = NULL;
+	AllocatorError error = AllocatorError_Ok;
+	ThreadCachingHeap* heap = (ThreadCachingHeap*)instance;
+
+	bool is_invalid_alignment = (!alignment || (alignment & alignment-1) != 0);
+
+	switch (mode)
+	{
+		case AllocatorMode_Alloc:
+		case AllocatorMode_AllocNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			result = ThreadCachingHeapAlloc(heap, size, alignment);
+			if (!result)
+				error = AllocatorError_OutOfMemory;
+			else if (mode == AllocatorMode_Alloc)
+				MemoryZero(result, size);
+		} break;
+		case AllocatorMode_Free:
+		{
+			ThreadCachingHeapFree(heap, old_ptr);
+		} break;
+		case AllocatorMode_Resize:
+		case AllocatorMode_ResizeNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0 || old_size < 0)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			result = ThreadCachingHeapResize(heap, old_ptr, old_size, size, alignment);
+			if (!result)
+			{
+				error = AllocatorError_OutOfMemory;
+				break;
+			}
+
+			intz kept_size = old_ptr ? old_size : 0;
+			if (mode == AllocatorMode_Resize && size > kept_size)
+				MemoryZero((uint8*)result + kept_size, size - kept_size);
+		} break;
+		case AllocatorMode_QueryFeatures:
+		{
+			SafeAssert(old_ptr && ((uintptr)old_ptr & sizeof(uint32)-1) == 0);
+			uint32* features_ptr = (uint32*)old_ptr;
+			*features_ptr =
+				AllocatorFeature_Alloc |
+				AllocatorFeature_AllocNonZeroed |
+				AllocatorFeature_Resize |
+				AllocatorFeature_ResizeNonZeroed |
+				AllocatorFeature_Free |
+				AllocatorFeature_AllocBatch |
+				AllocatorFeature_FreeBatch |
+				AllocatorFeature_QueryFeatures |
+				AllocatorFeature_QueryInfo |
+				AllocatorFeature_ResizeInPlace |
+				AllocatorFeature_ThreadSafe;
+		} break;
+		case AllocatorMode_QueryInfo:
+		{
+			SafeAssert(old_ptr);
+			ThreadCachingHeapQueryInfo(heap, (AllocatorInfo*)old_ptr);
+		} break;
+		case AllocatorMode_AllocBatch:
+		{
+			void** ptrs = (void**)old_ptr;
+			if (is_invalid_alignment || size < 0 || old_size < 0 || (!ptrs && old_size))
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+
+			for (intz i = 0; i < old_size; ++i)
+			{
+				ptrs[i] = ThreadCachingHeapAlloc(heap, size, alignment);
+				if (!ptrs[i])
+				{
+					while (i-- > 0)
+						ThreadCachingHeapFree(heap, ptrs[i]);
+					error = AllocatorError_OutOfMemory;
+					break;
+				}
+				MemoryZero(ptrs[i], size);
+			}
+			if (!error)
+				result = ptrs;
+		} break;
+		case AllocatorMode_FreeBatch:
+		{
+			void** ptrs = (void**)old_ptr;
+			for (intz i = 0; i < old_size; ++i)
+				ThreadCachingHeapFree(heap, ptrs[i]);
+		} break;
+		default:
+		{
+			error = AllocatorError_ModeNotImplemented;
+		} break;
+	}
+
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+	return result;
+}
+
+static inline Allocator
+AllocatorFromThreadCachingHeap(ThreadCachingHeap* heap)
+{
+	return (Allocator) {
+		.proc = ThreadCachingHeapAllocatorProc,
+		.instance = heap,
+	};
+}
+
+#endif //LJRE_BASE_THREAD_HEAP_H
@@ -0,0 +1,544 @@
+#ifndef LJRE_BASE_TLSF_H
+#define LJRE_BASE_TLSF_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+#include "base_arena.h"
+
+#ifndef CONFIG_TLSF_DEFAULT_POOL_SIZE
+#	define CONFIG_TLSF_DEFAULT_POOL_SIZE (1 << 20)
+#endif
+
+// NOTE(ljre): Two-level segregated fit heap. Free blocks are kept in size-class lists indexed by two
+//             bitmaps (a power of two, then 32 linear subdivisions of it), so finding a block, splitting it
+//             and coalescing it with its physical neighbours on free are all O(1).
+//
+//             Memory comes in pools pushed from 'arena' as needed. For a heap backed straight by virtual
+//             memory, give it an arena from ArenaReserve(); pools are then committed as the heap grows.
+#define TLSF_SL_COUNT_LOG2_ 5
+#define TLSF_SL_COUNT_ (1 << TLSF_SL_COUNT_LOG2_)
+#define TLSF_ALIGN_LOG2_ 4
+#define TLSF_ALIGN_ (1 << TLSF_ALIGN_LOG2_)
+#define TLSF_FL_SHIFT_ (TLSF_SL_COUNT_LOG2_ + TLSF_ALIGN_LOG2_)
+#define TLSF_SMALL_BLOCK_SIZE_ (1 << TLSF_FL_SHIFT_)
+#if defined(CONFIG_ARCH_AMD64) || defined(CONFIG_ARCH_AARCH64)
+#	define TLSF_FL_MAX_ 40
+#else
+#	define TLSF_FL_MAX_ 30
+#endif
+#define TLSF_FL_COUNT_ (TLSF_FL_MAX_ - TLSF_FL_SHIFT_ + 1)
+
+static_assert(TLSF_FL_COUNT_ <= 32, "first level bitmap is a uint32");
+
+struct TlsfBlock_ typedef TlsfBlock_;
+struct TlsfBlock_
+{
+	// NOTE(ljre): Payload size in bytes. The lowest bit is set when the block is free.
+	alignas(TLSF_ALIGN_) intz size;
+	TlsfBlock_* prev_phys;
+
+	// NOTE(ljre): Only valid while the block is free. This is where the payload starts.
+	alignas(TLSF_ALIGN_) TlsfBlock_* next_free;
+	TlsfBlock_* prev_free;
+};
+
+#define TLSF_HEADER_SIZE_ ((intz)offsetof(TlsfBlock_, next_free))
+#define TLSF_MIN_PAYLOAD_ (SignedSizeof(TlsfBlock_) - TLSF_HEADER_SIZE_)
+
+struct TlsfPool_ typedef TlsfPool_;
+struct TlsfPool_
+{
+	alignas(TLSF_ALIGN_) TlsfPool_* next;
+	intz size;
+};
+
+struct TlsfHeap
+{
+	Arena* arena;
+	intz pool_size;
+	TlsfPool_* pools;
+
+	intz used;
+	intz committed;
+
+	uint32 fl_bitmap;
+	uint32 sl_bitmap[TLSF_FL_COUNT_];
+	TlsfBlock_* free_lists[TLSF_FL_COUNT_][TLSF_SL_COUNT_];
+}
+typedef TlsfHeap;
+
+static inline TlsfHeap TlsfHeapCreate (Arena* arena, intz pool_size);
+static inline void*    TlsfHeapAlloc  (TlsfHeap* heap, intz size, intz alignment);
+static inline void*    TlsfHeapResize (TlsfHeap* heap, void* ptr, intz size, intz alignment);
+static inline void     TlsfHeapFree   (TlsfHeap* heap, void* ptr);
+static inline void     TlsfHeapFreeAll(TlsfHeap* heap);
+static inline intz     TlsfHeapBlockSize(void* ptr);
+
+static inline Allocator AllocatorFromTlsfHeap(TlsfHeap* heap);
+
+static inline TlsfHeap
+TlsfHeapCreate(Arena* arena, intz pool_size)
+{
+	SafeAssert(arena && pool_size >= 0);
+
+	if (!pool_size)
+		pool_size = CONFIG_TLSF_DEFAULT_POOL_SIZE;
+
+	TlsfHeap result = {
+		.arena = arena,
+		.pool_size = AlignUp(pool_size, TLSF_ALIGN_-1),
+	};
+
+	return result;
+}
+
+//- NOTE(ljre): Block helpers
+static inline TlsfBlock_*
+TlsfBlockFromPtr_(void* ptr)
+{ return (TlsfBlock_*)((uint8*)ptr - TLSF_HEADER_SIZE_); }
+
+static inline void*
+TlsfPtrFromBlock_(TlsfBlock_* block)
+{ return (uint8*)block + TLSF_HEADER_SIZE_; }
+
+static inline intz
+TlsfBlockSize_(TlsfBlock_* block)
+{ return block->size & ~(intz)1; }
+
+static inline bool
+TlsfBlockIsFree_(TlsfBlock_* block)
+{ return block->size & 1; }
+
+static inline TlsfBlock_*
+TlsfBlockNext_(TlsfBlock_* block)
+{ return (TlsfBlock_*)((uint8*)TlsfPtrFromBlock_(block) + TlsfBlockSize_(block)); }
+
+static inline void
+TlsfBlockSetSize_(TlsfBlock_* block, intz size)
+{
+	block->size = size | (block->size & 1);
+	TlsfBlockNext_(block)->prev_phys = block;
+}
+
+static inline void
+TlsfMapping_(intz size, int32* out_fl, int32* out_sl)
+{
+	if (size < TLSF_SMALL_BLOCK_SIZE_)
+	{
+		*out_fl = 0;
+		*out_sl = (int32)(size >> TLSF_ALIGN_LOG2_);
+	}
+	else
+	{
+		int32 msb = 63 - BitClz64((uint64)size);
+		*out_sl = (int32)(size >> (msb - TLSF_SL_COUNT_LOG2_)) ^ TLSF_SL_COUNT_;
+		*out_fl = msb - TLSF_FL_SHIFT_ + 1;
+	}
+}
+
+static inline void
+TlsfInsertFree_(TlsfHeap* heap, TlsfBlock_* block)
+{
+	int32 fl, sl;
+	TlsfMapping_(TlsfBlockSize_(block), &fl, &sl);
+
+	TlsfBlock_* head = heap->free_lists[fl][sl];
+	block->size |= 1;
+	block->next_free = head;
+	block->prev_free = NULL;
+	if (head)
+		head->prev_free = block;
+
+	heap->free_lists[fl][sl] = block;
+	heap->fl_bitmap |= 1u << fl;
+	heap->sl_bitmap[fl] |= 1u << sl;
+}
+
+static inline void
+TlsfRemoveFree_(TlsfHeap* heap, TlsfBlock_* block)
+{
+	int32 fl, sl;
+	TlsfMapping_(TlsfBlockSize_(block), &fl, &sl);
+
+	if (block->next_free)
+		block->next_free->prev_free = block->prev_free;
+	if (block->prev_free)
+		block->prev_free->next_free = block->next_free;
+	else
+	{
+		heap->free_lists[fl][sl] = block->next_free;
+		if (!block->next_free)
+		{
+			heap->sl_bitmap[fl] &= ~(1u << sl);
+			if (!heap->sl_bitmap[fl])
+				heap->fl_bitmap &= ~(1u << fl);
+		}
+	}
+
+	block->size &= ~(intz)1;
+}
+
+// NOTE(ljre): Takes a free block, or a used block that just had its physical neighbours checked, merges
+//             it with free neighbours and puts it in the free lists.
+static inline void
+TlsfReleaseBlock_(TlsfHeap* heap, TlsfBlock_* block)
+{
+	TlsfBlock_* next = TlsfBlockNext_(block);
+	if (TlsfBlockIsFree_(next))
+	{
+		TlsfRemoveFree_(heap, next);
+		TlsfBlockSetSize_(block, TlsfBlockSize_(block) + TLSF_HEADER_SIZE_ + TlsfBlockSize_(next));
+	}
+
+	TlsfBlock_* prev = block->prev_phys;
+	if (prev && TlsfBlockIsFree_(prev))
+	{
+		TlsfRemoveFree_(heap, prev);
+		TlsfBlockSetSize_(prev, TlsfBlockSize_(prev) + TLSF_HEADER_SIZE_ + TlsfBlockSize_(block));
+		block = prev;
+	}
+
+	TlsfInsertFree_(heap, block);
+}
+
+// NOTE(ljre): Cuts a used block down to 'size' bytes of payload, giving the rest back to the free lists if
+//             it's big enough to be a block on its own.
+static inline void
+TlsfTrimUsed_(TlsfHeap* heap, TlsfBlock_* block, intz size)
+{
+	intz block_size = TlsfBlockSize_(block);
+	if (block_size - size < TLSF_HEADER_SIZE_ + TLSF_MIN_PAYLOAD_)
+		return;
+
+	TlsfBlock_* remainder = (TlsfBlock_*)((uint8*)TlsfPtrFromBlock_(block) + size);
+	remainder->size = 0;
+	TlsfBlockSetSize_(remainder, block_size - size - TLSF_HEADER_SIZE_);
+	TlsfBlockSetSize_(block, size);
+	TlsfReleaseBlock_(heap, remainder);
+}
+
+static inline intz
+TlsfAdjustSize_(intz size)
+{
+	if (size > ((intz)1 << (TLSF_FL_MAX_ - 1)))
+		return -1;
+	return Max(AlignUp(size, TLSF_ALIGN_-1), TLSF_MIN_PAYLOAD_);
+}
+
+static TlsfBlock_*
+TlsfFindFree_(TlsfHeap* heap, intz size)
+{
+	// NOTE(ljre): Round the request up to the next size class, so that any block in it fits.
+	if (size >= TLSF_SMALL_BLOCK_SIZE_)
+	{
+		int32 msb = 63 - BitClz64((uint64)size);
+		size += ((intz)1 << (msb - TLSF_SL_COUNT_LOG2_)) - 1;
+	}
+
+	int32 fl, sl;
+	TlsfMapping_(size, &fl, &sl);
+	if (fl >= TLSF_FL_COUNT_)
+		return NULL;
+
+	uint32 sl_map = heap->sl_bitmap[fl] & (~0u << sl);
+	if (!sl_map)
+	{
+		uint32 fl_map = (fl + 1 < 32) ? heap->fl_bitmap & (~0u << (fl + 1)) : 0;
+		if (!fl_map)
+			return NULL;
+		fl = BitCtz32(fl_map);
+		sl_map = heap->sl_bitmap[fl];
+	}
+	sl = BitCtz32(sl_map);
+
+	TlsfBlock_* block = heap->free_lists[fl][sl];
+	TlsfRemoveFree_(heap, block);
+	return block;
+}
+
+// NOTE(ljre): Returns the new pool as a single block, already out of the free lists.
+static TlsfBlock_*
+TlsfAddPool_(TlsfHeap* heap, intz needed)
+{
+	Trace();
+	intz overhead = SignedSizeof(TlsfPool_) + 2*TLSF_HEADER_SIZE_;
+	if (needed > INTZ_MAX - overhead)
+		return NULL;
+	intz size = Max(heap->pool_size, needed + overhead);
+
+	TlsfPool_* pool = (TlsfPool_*)ArenaPushDirtyAligned(heap->arena, size, TLSF_ALIGN_);
+	if (!pool)
+		return NULL;
+
+	pool->next = heap->pools;
+	pool->size = size;
+	heap->pools = pool;
+	heap->committed += size;
+
+	// NOTE(ljre): A zero-sized used block at the end of the pool stops coalescing from walking off of it.
+	TlsfBlock_* block = (TlsfBlock_*)(pool + 1);
+	TlsfBlock_* sentinel = (TlsfBlock_*)((uint8*)pool + size - TLSF_HEADER_SIZE_);
+	sentinel->size = 0;
+	block->size = 0;
+	block->prev_phys = NULL;
+	TlsfBlockSetSize_(block, size - overhead);
+	return block;
+}
+
+//- NOTE(ljre): Heap functions
+static inline void*
+TlsfHeapAlloc(TlsfHeap* heap, intz size, intz alignment)
+{
+	SafeAssert(size >= 0);
+	Assert(alignment > 0 && IsPowerOf2(alignment));
+
+	intz adjusted = TlsfAdjustSize_(size);
+	if (Unlikely(adjusted < 0))
+		return NULL;
+
+	// NOTE(ljre): For big alignments, ask for enough slack to cut a free block off of the front.
+	intz gap_max = 0;
+	if (alignment > TLSF_ALIGN_)
+		gap_max = alignment + TLSF_HEADER_SIZE_ + TLSF_MIN_PAYLOAD_;
+
+	TlsfBlock_* block = TlsfFindFree_(heap, adjusted + gap_max);
+	if (!block)
+		block = TlsfAddPool_(heap, adjusted + gap_max);
+	if (!block)
+		return NULL;
+
+	if (gap_max)
+	{
+		uintptr ptr = (uintptr)TlsfPtrFromBlock_(block);
+		intz gap = (intz)(AlignUp(ptr, (uintptr)alignment-1) - ptr);
+		if (gap && gap < TLSF_HEADER_SIZE_ + TLSF_MIN_PAYLOAD_)
+			gap += alignment;
+
+		if (gap)
+		{
+			TlsfBlock_* aligned = (TlsfBlock_*)((uint8*)block + gap);
+			aligned->size = 0;
+			TlsfBlockSetSize_(aligned, TlsfBlockSize_(block) - gap);
+			TlsfBlockSetSize_(block, gap - TLSF_HEADER_SIZE_);
+			TlsfReleaseBlock_(heap, block);
+			block = aligned;
+		}
+	}
+
+	TlsfTrimUsed_(heap, block, adjusted);
+	heap->used += TlsfBlockSize_(block);
+	return TlsfPtrFromBlock_(block);
+}
+
+static inline void
+TlsfHeapFree(TlsfHeap* heap, void* ptr)
+{
+	if (!ptr)
+		return;
+
+	TlsfBlock_* block = TlsfBlockFromPtr_(ptr);
+	SafeAssert(!TlsfBlockIsFree_(block));
+	heap->used -= TlsfBlockSize_(block);
+	TlsfReleaseBlock_(heap, block);
+}
+
+static inline void*
+TlsfHeapResize(TlsfHeap* heap, void* ptr, intz size, intz alignment)
+{
+	if (!ptr)
+		return TlsfHeapAlloc(heap, size, alignment);
+
+	Assert(alignment > 0 && IsPowerOf2(alignment));
+	intz adjusted = TlsfAdjustSize_(size);
+	if (Unlikely(adjusted < 0))
+		return NULL;
+
+	TlsfBlock_* block = TlsfBlockFromPtr_(ptr);
+	intz block_size = TlsfBlockSize_(block);
+	SafeAssert(!TlsfBlockIsFree_(block));
+
+	if (((uintptr)ptr & (uintptr)alignment-1) == 0)
+	{
+		// NOTE(ljre): Grow into the next block if it's free and big enough.
+		TlsfBlock_* next = TlsfBlockNext_(block);
+		if (adjusted > block_size && TlsfBlockIsFree_(next) && block_size + TLSF_HEADER_SIZE_ + TlsfBlockSize_(next) >= adjusted)
+		{
+			TlsfRemoveFree_(heap, next);
+			TlsfBlockSetSize_(block, block_size + TLSF_HEADER_SIZE_ + TlsfBlockSize_(next));
+		}
+
+		if (adjusted <= TlsfBlockSize_(block))
+		{
+			TlsfTrimUsed_(heap, block, adjusted);
+			heap->used += TlsfBlockSize_(block) - block_size;
+			return ptr;
+		}
+	}
+
+	void* result = TlsfHeapAlloc(heap, size, alignment);
+	if (result)
+	{
+		MemoryCopy(result, ptr, Min(block_size, adjusted));
+		TlsfHeapFree(heap, ptr);
+	}
+
+	return result;
+}
+
+static inline void
+TlsfHeapFreeAll(TlsfHeap* heap)
+{
+	Trace();
+	heap->used = 0;
+	heap->fl_bitmap = 0;
+	MemoryZero(heap->sl_bitmap, SignedSizeof(heap->sl_bitmap));
+	MemoryZero(heap->free_lists, SignedSizeof(heap->free_lists));
+
+	for (TlsfPool_* pool = heap->pools; pool; pool = pool->next)
+	{
+		TlsfBlock_* block = (TlsfBlock_*)(pool + 1);
+		block->size = 0;
+		TlsfBlockSetSize_(block, pool->size - SignedSizeof(TlsfPool_) - 2*TLSF_HEADER_SIZE_);
+		TlsfInsertFree_(heap, block);
+	}
+}
+
+static inline intz
+TlsfHeapBlockSize(void* ptr)
+{ return TlsfBlockSize_(TlsfBlockFromPtr_(ptr)); }
+
+static void*
+TlsfHeapAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	Trace();
+	void* result = NULL;
+	AllocatorError error = AllocatorError_Ok;
+	TlsfHeap* heap = (TlsfHeap*)instance;
+
+	bool is_invalid_alignment = (!alignment || (alignment & alignment-1) != 0);
+
+	switch (mode)
+	{
+		case AllocatorMode_Alloc:
+		case AllocatorMode_AllocNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			result = TlsfHeapAlloc(heap, size, alignment);
+			if (!result)
+				error = AllocatorError_OutOfMemory;
+			else if (mode == AllocatorMode_Alloc)
+				MemoryZero(result, size);
+		} break;
+		case AllocatorMode_Free:
+		{
+			SafeAssert(!old_ptr || old_size <= TlsfHeapBlockSize(old_ptr));
+			TlsfHeapFree(heap, old_ptr);
+		} break;
+		case AllocatorMode_Resize:
+		case AllocatorMode_ResizeNonZeroed:
+		{
+			if (is_invalid_alignment || size < 0 || old_size < 0)
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+			SafeAssert(!old_ptr || old_size <= TlsfHeapBlockSize(old_ptr));
+
+			result = TlsfHeapResize(heap, old_ptr, size, alignment);
+			if (!result)
+			{
+				error = AllocatorError_OutOfMemory;
+				break;
+			}
+
+			intz kept_size = old_ptr ? old_size : 0;
+			if (mode == AllocatorMode_Resize && size > kept_size)
+				MemoryZero((uint8*)result + kept_size, size - kept_size);
+		} break;
+		case AllocatorMode_FreeAll:
+		{
+			TlsfHeapFreeAll(heap);
+		} break;
+		case AllocatorMode_QueryFeatures:
+		{
+			SafeAssert(old_ptr && ((uintptr)old_ptr & sizeof(uint32)-1) == 0);
+			uint32* features_ptr = (uint32*)old_ptr;
+			*features_ptr =
+				AllocatorFeature_Alloc |
+				AllocatorFeature_AllocNonZeroed |
+				AllocatorFeature_Resize |
+				AllocatorFeature_ResizeNonZeroed |
+				AllocatorFeature_Free |
+				AllocatorFeature_FreeAll |
+				AllocatorFeature_AllocBatch |
+				AllocatorFeature_FreeBatch |
+				AllocatorFeature_QueryFeatures |
+				AllocatorFeature_QueryInfo |
+				AllocatorFeature_ResizeInPlace;
+		} break;
+		case AllocatorMode_QueryInfo:
+		{
+			SafeAssert(old_ptr);
+			AllocatorInfo* info = (AllocatorInfo*)old_ptr;
+			info->used = heap->used;
+			info->committed = heap->committed;
+			info->reserved = heap->committed;
+			info->thread_safe = false;
+		} break;
+		case AllocatorMode_AllocBatch:
+		{
+			void** ptrs = (void**)old_ptr;
+			if (is_invalid_alignment || size < 0 || old_size < 0 || (!ptrs && old_size))
+			{
+				error = AllocatorError_InvalidArgument;
+				break;
+			}
+
+			for (intz i = 0; i < old_size; ++i)
+			{
+				ptrs[i] = TlsfHeapAlloc(heap, size, alignment);
+				if (!ptrs[i])
+				{
+					while (i-- > 0)
+						TlsfHeapFree(heap, ptrs[i]);
+					error = AllocatorError_OutOfMemory;
+					break;
+				}
+				MemoryZero(ptrs[i], size);
+			}
+			if (!error)
+				result = ptrs;
+		} break;
+		case AllocatorMode_FreeBatch:
+		{
+			void** ptrs = (void**)old_ptr;
+			for (intz i = 0; i < old_size; ++i)
+				TlsfHeapFree(heap, ptrs[i]);
+		} break;
+		default:
+		{
+			error = AllocatorError_ModeNotImplemented;
+		} break;
+	}
+
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+	return result;
+}
+
+static inline Allocator
+AllocatorFromTlsfHeap(TlsfHeap* heap)
+{
+	return (Allocator) {
+		.proc = TlsfHeapAllocatorProc,
+		.instance = heap,
+	};
+}
+
+#endif //LJRE_BASE_TLSF_H
@@ -0,0 +1,224 @@
+#ifndef LJRE_BASE_TRACKING_ALLOCATOR_H
+#define LJRE_BASE_TRACKING_ALLOCATOR_H
+
+#include "base.h"
+#include "base_intrinsics.h"
+
+// NOTE(ljre): Allocator that forwards every call to 'inner' and records how many calls each mode got, a
+//             histogram of their sizes (powers of 2), how many cycles they took (ReadCycleCounter()), and
+//             the live and peak number of bytes. Allocators from TrackingAllocatorAddSite() also count their
+//             calls under a tag, so a report can show which subsystem is behind them.
+//
+//             The counters are plain integers: a tracker shouldn't be shared between threads, even if
+//             'inner' is thread-safe. Live bytes can't follow AllocatorMode_Pop, since it has no size.
+#define TRACKING_ALLOCATOR_MODE_COUNT (AllocatorMode_FreeBatch + 1)
+#define TRACKING_ALLOCATOR_BUCKET_COUNT 40
+
+struct TrackingAllocator typedef TrackingAllocator;
+struct TrackingAllocatorSite typedef TrackingAllocatorSite;
+
+struct TrackingAllocatorSite
+{
+	TrackingAllocator* tracker;
+	TrackingAllocatorSite* next;
+	char const* tag;
+
+	int64 calls;
+	int64 cycles;
+	intz live_bytes;
+	intz peak_bytes;
+};
+
+struct TrackingAllocator
+{
+	Allocator inner;
+	TrackingAllocatorSite untagged;
+	TrackingAllocatorSite* sites;
+
+	intz live_bytes;
+	intz peak_bytes;
+	int64 calls[TRACKING_ALLOCATOR_MODE_COUNT];
+	int64 failures[TRACKING_ALLOCATOR_MODE_COUNT];
+	int64 cycles[TRACKING_ALLOCATOR_MODE_COUNT];
+	int64 size_histogram[TRACKING_ALLOCATOR_MODE_COUNT][TRACKING_ALLOCATOR_BUCKET_COUNT];
+};
+
+static void*            TrackingAllocatorProc   (void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err);
+static inline void      TrackingAllocatorInit   (TrackingAllocator* tracker, Allocator inner);
+static inline Allocator TrackingAllocatorAddSite(TrackingAllocator* tracker, TrackingAllocatorSite* site, char const* tag);
+static inline void      TrackingAllocatorLogReport(int32 level, TrackingAllocator* tracker);
+
+static inline Allocator AllocatorFromTrackingAllocator(TrackingAllocator* tracker);
+
+static inline void
+TrackingAllocatorInit(TrackingAllocator* tracker, Allocator inner)
+{
+	MemoryZero(tracker, SignedSizeof(*tracker));
+	tracker->inner = inner;
+	tracker->untagged.tracker = tracker;
+	tracker->untagged.tag = "(untagged)";
+	tracker->sites = &tracker->untagged;
+}
+
+static inline Allocator
+TrackingAllocatorAddSite(TrackingAllocator* tracker, TrackingAllocatorSite* site, char const* tag)
+{
+	MemoryZero(site, SignedSizeof(*site));
+	site->tracker = tracker;
+	site->tag = tag;
+	site->next = tracker->sites;
+	tracker->sites = site;
+
+	return (Allocator) {
+		.proc = TrackingAllocatorProc,
+		.instance = site,
+	};
+}
+
+static inline int32
+TrackingAllocatorBucket_(intz size)
+{
+	if (size <= 0)
+		return 0;
+	return ClampMax(64 - BitClz64((uint64)size), TRACKING_ALLOCATOR_BUCKET_COUNT-1);
+}
+
+static void*
+TrackingAllocatorProc(void* instance, AllocatorMode mode, intz size, intz alignment, void* old_ptr, intz old_size, AllocatorError* out_err)
+{
+	TrackingAllocatorSite* site = (TrackingAllocatorSite*)instance;
+	TrackingAllocator* tracker = site->tracker;
+	AllocatorError error = AllocatorError_Ok;
+
+	uint64 begin = ReadCycleCounter();
+	void* result = tracker->inner.proc(tracker->inner.instance, mode, size, alignment, old_ptr, old_size, &error);
+	int64 cycles = (int64)(ReadCycleCounter() - begin);
+
+	if (mode == AllocatorMode_QueryFeatures && error == AllocatorError_Ok)
+		*(uint32*)old_ptr &= ~(uint32)AllocatorFeature_ThreadSafe;
+	else if (mode == AllocatorMode_QueryInfo && error == AllocatorError_Ok)
+		((AllocatorInfo*)old_ptr)->thread_safe = false;
+
+	if ((uint32)mode < TRACKING_ALLOCATOR_MODE_COUNT)
+	{
+		intz sample_size = (mode == AllocatorMode_Free) ? old_size : size;
+		tracker->calls[mode] += 1;
+		tracker->cycles[mode] += cycles;
+		tracker->size_histogram[mode][TrackingAllocatorBucket_(sample_size)] += 1;
+		if (error)
+			tracker->failures[mode] += 1;
+	}
+	site->calls += 1;
+	site->cycles += cycles;
+
+	if (!error)
+	{
+		intz delta = 0;
+		switch (mode)
+		{
+			case AllocatorMode_Alloc:
+			case AllocatorMode_AllocNonZeroed: delta = size; break;
+			case AllocatorMode_Resize:
+			case AllocatorMode_ResizeNonZeroed: delta = size - (old_ptr ? old_size : 0); break;
+			case AllocatorMode_Free: delta = old_ptr ? -old_size : 0; break;
+			case AllocatorMode_AllocBatch: delta = size * old_size; break;
+			case AllocatorMode_FreeBatch:
+			{
+				for (intz i = 0; i < old_size; ++i)
+					delta -= ((void**)old_ptr)[i] ? size : 0;
+			} break;
+			case AllocatorMode_FreeAll:
+			{
+				tracker->live_bytes = 0;
+				for (TrackingAllocatorSite* it = tracker->sites; it; it = it->next)
+					it->live_bytes = 0;
+			} break;
+			default: break;
+		}
+
+		tracker->live_bytes += delta;
+		tracker->peak_bytes = Max(tracker->peak_bytes, tracker->live_bytes);
+		site->live_bytes += delta;
+		site->peak_bytes = Max(site->peak_bytes, site->live_bytes);
+	}
+
+	if (out_err)
+		*out_err = error;
+	else
+		SafeAssert(error == AllocatorError_Ok);
+	return result;
+}
+
+static inline void
+TrackingAllocatorLogReport(int32 level, TrackingAllocator* tracker)
+{
+	Trace();
+	// NOTE(ljre): Same order as AllocatorMode.
+	static char const* const mode_names[TRACKING_ALLOCATOR_MODE_COUNT] = {
+		"Alloc",
+		"Free",
+		"FreeAll",
+		"Resize",
+		"QueryFeatures",
+		"QueryInfo",
+		"AllocNonZeroed",
+		"ResizeNonZeroed",
+		"Pop",
+		"AllocBatch",
+		"FreeBatch",
+	};
+
+	Log(level, "tracking allocator: live=%Z peak=%Z", tracker->live_bytes, tracker->peak_bytes);
+
+	for (int32 mode = 0; mode < TRACKING_ALLOCATOR_MODE_COUNT; ++mode)
+	{
+		int64 calls = tracker->calls[mode];
+		if (!calls)
+			continue;
+
+		Log(level, "  %s: calls=%I failures=%I cycles=%I avg_cycles=%I",
+			mode_names[mode],
+			calls,
+			tracker->failures[mode],
+			tracker->cycles[mode],
+			tracker->cycles[mode] / calls);
+
+		for (int32 bucket = 0; bucket < TRACKING_ALLOCATOR_BUCKET_COUNT; ++bucket)
+		{
+			int64 count = tracker->size_histogram[mode][bucket];
+			if (!count)
+				continue;
+
+			if (bucket == 0)
+				Log(level, "    0 bytes: %I", count);
+			else if (bucket == TRACKING_ALLOCATOR_BUCKET_COUNT-1)
+				Log(level, "    %U.. bytes: %I", (uint64)1 << (bucket-1), count);
+			else
+				Log(level, "    %U..%U bytes: %I", (uint64)1 << (bucket-1), ((uint64)1 << bucket) - 1, count);
+		}
+	}
+
+	for (TrackingAllocatorSite* site = tracker->sites; site; site = site->next)
+	{
+		if (!site->calls)
+			continue;
+
+		Log(level, "  site '%s': calls=%I cycles=%I live=%Z peak=%Z",
+			site->tag,
+			site->calls,
+			site->cycles,
+			site->live_bytes,
+			site->peak_bytes);
+	}
+}
+
+static inline Allocator
+AllocatorFromTrackingAllocator(TrackingAllocator* tracker)
+{
+	return (Allocator) {
+		.proc = TrackingAllocatorProc,
+		.instance = &tracker->untagged,
+	};
+}
+
+#endif //LJRE_BASE_TRACKING_ALLOCATOR_H